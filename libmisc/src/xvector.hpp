@@ -1,39 +1,30 @@
 #ifndef XVECTOR_HPP
 #define XVECTOR_HPP
 #include <vector>
-// FIXME: What is the most efficient way to move an element
-// to a different position in the same vector?
-// Option 1: std::rotate seems to be slower than erase + insert!
-// template<typename T>
-// static void
-// reinsert(std::vector<T> & v, size_t from, size_t to)
-// {
-//     typename std::vector<T>::iterator first, middle, last;
-//     if (from < to) {
-//         first  = v.begin() + from;
-//         middle = first + 1;
-//         last   = v.begin() + to;
-//     } else {
-//         first  = v.begin() + to;
-//         middle = v.begin() + from;
-//         last   = middle + 1;
-//     }
-//     std::rotate(first, middle, last);
-// }
-// FIXME: For sure we do not need to pass the element.
+#include <algorithm>
+#include <cassert>
+// Move the element at position from to position to, shifting the
+// elements in between by one. Only those elements are moved, so this
+// is O(|from - to|) rather than O(size) as erase + insert.
+// std::rotate does the same but was slower, since it does not use
+// memmove.
 template<class T>
-static void reinsert(std::vector<T> &v, const T &element, int from, int to)
+static void reinsert(std::vector<T> &v, int from, int to)
 {
-    v.erase(v.begin() + from);
-    v.insert(v.begin() + to, element);
+    T element = v[from];
+    if (from < to)
+        std::move(v.begin() + from + 1, v.begin() + to + 1, v.begin() + from);
+    else
+        std::move_backward(v.begin() + to, v.begin() + from,
+                           v.begin() + from + 1);
+    v[to] = element;
 }
 
 template<class T>
-static void reinsert(std::vector<T> &v, int from, int to)
+static void reinsert(std::vector<T> &v, const T &element, int from, int to)
 {
-    const T element = v[from];
-    v.erase(v.begin() + from);
-    v.insert(v.begin() + to, element);
+    assert(v[from] == element);
+    reinsert(v, from, to);
 }
 
 #include <cmath> // sqrt
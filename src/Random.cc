@@ -77,3 +77,16 @@ vector<int> Random::generate_vector(int size)
   }
   return v;
 }
+
+/* Streams with nearby seeds are strongly correlated in this generator,
+   so SEED and STREAM are mixed with the splitmix64 finaliser
+   (Steele, Lea and Flood, OOPSLA 2014) and mapped into [1, IM - 1].  */
+long int Random::derive_seed (long int seed, unsigned long stream)
+{
+  unsigned long long z = (unsigned long long) seed
+    + 0x9E3779B97F4A7C15ULL * ((unsigned long long) stream + 1);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z = z ^ (z >> 31);
+  return 1 + long(z % (unsigned long long)(IM - 1));
+}
@@ -39,6 +39,9 @@ public:
 
   vector<int> generate_vector(int size);
   int * generate_array(int size);
+
+  // Seed for the independent stream number STREAM derived from SEED.
+  static long int derive_seed (long int seed, unsigned long stream);
 };
 #endif
 // Local Variables:
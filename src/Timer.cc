@@ -16,6 +16,8 @@
  ***************************************************************************/
 #include "Timer.h"
 
+Timer::CLOCK Timer::default_clock = Timer::PROCESS_TIME;
+
 #define TIMER_CPUTIME(X) ( (double)X.ru_utime.tv_sec  +         \
                            (double)X.ru_stime.tv_sec  +         \
                           ((double)X.ru_utime.tv_usec +         \
@@ -28,6 +30,13 @@
  *  to get the amount of time used by the algorithm.
  */
 Timer::Timer(void)
+  : clock (default_clock)
+{
+  this->reset();
+}
+
+Timer::Timer(CLOCK clock)
+  : clock (clock)
 {
   this->reset();
 }
@@ -48,14 +57,16 @@ double Timer::elapsed_time(const TYPE& type) {
 double Timer::elapsed_time_virtual (void)
 {
     double timer_tmp_time;
-    getrusage (RUSAGE_SELF, &res);
+    if (clock == WALL_TIME)
+      return elapsed_time (REAL);
+    getrusage (clock == THREAD_TIME ? RUSAGE_THREAD : RUSAGE_SELF, &res);
     timer_tmp_time = TIMER_CPUTIME(res) - virtual_time;
     return (timer_tmp_time < 0.0) ? 0 : timer_tmp_time;
 }
 
 void Timer::reset(void)
 {
-  getrusage( RUSAGE_SELF, &res );
+  getrusage( clock == THREAD_TIME ? RUSAGE_THREAD : RUSAGE_SELF, &res );
   virtual_time = (double) res.ru_utime.tv_sec +
     (double) res.ru_stime.tv_sec +
     (double) res.ru_utime.tv_usec * 1.0E-6 +
@@ -31,9 +31,18 @@ private:
 
 public:
   enum TYPE {REAL, VIRTUAL};
+  // What elapsed_time_virtual() measures: the CPU time of the process,
+  // the CPU time of the thread that calls it, or the wall-clock time.
+  enum CLOCK {PROCESS_TIME, THREAD_TIME, WALL_TIME};
+  // The clock of timers created without one.
+  static CLOCK default_clock;
   Timer(void);
+  explicit Timer(CLOCK clock);
   double elapsed_time(const TYPE& type);
   double elapsed_time_virtual(void);
   void reset(void);
+
+private:
+  CLOCK clock;
 };
 #endif
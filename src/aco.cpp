@@ -39,20 +39,21 @@ extern char * program_invocation_short_name;
 #include "Random.h"
 #include "Timer.h"
 #include "ant.h"
+#include "migration.h"
+#include "peers.h"
 #include <string>
 #include <cstring>
 #include <list>
 #include <vector>
 #include <climits>
+#include <mutex>
+#include <thread>
 
 unsigned int random_seed;
 
-// the following five variables are involved in termination criteria issues
+// the following two variables are involved in termination criteria issues
 int n_of_iter = INT_MAX;
 double time_limit = DBL_MAX;
-double time_taken;
-double time_localsearch;
-double time_init;
 
 // n_of_ants: the number of ants
 int n_of_ants = 1;
@@ -75,12 +76,34 @@ int n_of_trials = 1;
 int beam_width = 1;
 double mu = 2.0;
 int max_children = 100;
+int to_choose;
 
 // stochastic sampling parameter
 int n_samples = 10;
 int sample_percent = 100;
 int sample_rate = -1;
 
+// number of threads used to build the ants of an iteration, or within
+// each solution construction if there is only one ant
+int n_threads = 1;
+
+// number of trials run at the same time, each one in a single thread
+int n_parallel_trials = 1;
+
+// island model: number of colonies run at the same time in each trial,
+// and how often and between which of them best-so-far tours migrate
+int n_islands = 1;
+int migration_interval = 10;
+migration_topology_t migration_topology = MIGRATION_RING;
+
+// other processes that exchange their best tours with this one, and
+// where this one receives theirs
+vector<string> peer_addresses;
+string listen_address;
+
+// length of the candidate lists, 0 if they are not used
+int candidate_list_size = 0;
+
 
 // variable that holds the name of the input file
 string input_filename;
@@ -89,12 +112,85 @@ FILE *trace_stream;
 string trace_filename;
 
 
-/* Initialization of the three solutions 'best_so_far', 'restart_best'
-   and 'iteration_best', which are used to update the pheromone
-   values */
-Solution* best_so_far = NULL;
-Solution* restart_best = NULL;
-Solution* iteration_best = NULL;
+/* One run of Beam-ACO on an instance: its colony, the constructions
+   of its ants, its random numbers, the solutions used to update the
+   pheromone and the statistics of the current trial. Solvers only
+   share the instance and the pool of threads, so several of them may
+   run in the same process.  */
+class Solver
+{
+public:
+  Solver (const Instance *instance, Thread_Pool *thread_pool,
+          Peers *peers = NULL, Migration *migration = NULL, int island = 0);
+  ~Solver ();
+
+  void begin_trial (int trial, long seed);
+  void iterate (void);
+  bool finished (void) const {
+    return trial_time >= time_limit || iter > n_of_iter;
+  }
+
+  Colony colony;
+  int trial;
+  // The next iteration.
+  int iter;
+
+  /* The three solutions 'best_so_far', 'restart_best' and
+     'iteration_best' are used to update the pheromone values.  */
+  Solution *best_so_far;
+  Solution *restart_best;
+  Solution *iteration_best;
+  // Iteration and time at which best_so_far was found.
+  int best_iter;
+  double best_time;
+
+  double trial_time;
+  double time_init;
+  double time_localsearch;
+  double time_sampling;
+
+  // Where the improvements of best_so_far are traced.
+  FILE *trace;
+
+  // Other processes, or NULL if there are none.
+  Peers *peers;
+  // Islands of the trial, or NULL if this is the only colony.
+  Migration *migration;
+  int island;
+
+private:
+  Random rng;
+  Timer timer;
+  // Each ant of an iteration has its own construction, so that they
+  // can be built concurrently.
+  vector<Construction> constructions;
+  vector<Solution*> ant_solution;
+  vector<double> ant_time_localsearch;
+  // Pheromone deposits of the current update, see update_pheromone().
+  vector<pair<pair<int,int>, double> > deposit;
+
+  /* bs_update regulates the use of the best_so_far solution for
+     updating, restart controls the restart mechanism of the
+     algorithm.  */
+  bool bs_update;
+  bool restart;
+
+  // Whether best_so_far changed since it was last published, and the
+  // version of the last tour received from each island.
+  bool best_changed;
+  vector<unsigned long> migrants_seen;
+  vector<int> migrant_tour;
+  // Best tour received from other processes, and its version.
+  Solution *remote_best;
+  unsigned long remote_seen;
+
+  void build_ant (size_t i, long seed);
+  void receive_migrants (void);
+  bool receive_remote (void);
+  void update_best_so_far (void);
+  void update_pheromone (double cf);
+  double convergence_factor (void);
+};
 
 #include "common.h"
 
@@ -128,9 +224,38 @@ static void usage(void)
 "     --lrate      learning rate used for updating pheromones (default: %g).\n"
 "     --detrate    rate of determinism in the solution construction         \n"
 "                  (default: %g).                                           \n"
-"     --ls=<no | first | best> local search type.                           \n"
+"     --ls=<no | first | best | oropt> local search type.                   \n"
+"     --wheel=<linear | alias> roulette wheel used to sample the next node  \n"
+"                  (default: linear).                                       \n"
+"     --threads INT number of threads used to build the ants of an       \n"
+"                  iteration, or to expand the beam if there is only one   \n"
+"                  ant; with more than one, the time limit and the times   \n"
+"                  are wall-clock times (default: %d).                     \n"
+"     --candidates INT length of the candidate lists used to choose the next\n"
+"                  node, 0 means no candidate lists (default: %d).         \n"
+"     --dominance=<yes | no> remove beam children that reach the same state \n"
+"                  (customers and last customer) as another child that is \n"
+"                  at least as good in constraint violations, makespan and \n"
+"                  tour cost (default: no).                                \n"
+"     --parallel-trials INT number of trials run at the same time, each   \n"
+"                  one in a single thread; --threads is then ignored and   \n"
+"                  times are CPU times of the thread (default: %d).        \n"
+"     --islands INT number of colonies of each trial, run at the same time \n"
+"                  on as many threads, that exchange their best tours;     \n"
+"                  --threads is then ignored and times are CPU times of    \n"
+"                  the thread running the island (default: %d).            \n"
+"     --migration-interval INT iterations between exchanges of tours      \n"
+"                  among islands (default: %d).                            \n"
+"     --migration=<ring | all> each island takes the tour of the previous \n"
+"                  island or those of all the others (default: ring).      \n"
+"     --listen ADDRESS receive the best tours of other processes at       \n"
+"                  ADDRESS, either HOST:PORT or unix:PATH.                 \n"
+"     --peer ADDRESS send the best tours to the process listening at      \n"
+"                  ADDRESS; may be given several times.                    \n"
 "\n",
-n_of_ants, beam_width, mu, n_samples, sample_percent, max_children, l_rate, det_rate);
+n_of_ants, beam_width, mu, n_samples, sample_percent, max_children, l_rate, det_rate,
+n_threads, candidate_list_size, n_parallel_trials, n_islands,
+migration_interval);
 }
 
 static void print_version(void)
@@ -250,10 +375,73 @@ static void read_parameters(int argc, char **argv)
              or strequal (argv[iarg],"-ls=best")) {
       Solution::localsearch_type = LOCALSEARCH_BEST;
     }
+    else if (strequal (argv[iarg],"--ls=oropt")
+             or strequal (argv[iarg],"-ls=oropt")) {
+      Solution::localsearch_type = LOCALSEARCH_OROPT;
+    }
     else if (strequal (argv[iarg],"--ls=first")
              or strequal (argv[iarg],"-ls=first")) {
       Solution::localsearch_type = LOCALSEARCH_FIRST;
     }
+    else if (strequal (argv[iarg],"--wheel=linear")) {
+      Ant::wheel_type = WHEEL_LINEAR;
+    }
+    else if (strequal (argv[iarg],"--wheel=alias")) {
+      Ant::wheel_type = WHEEL_ALIAS;
+    }
+    else if (strequal (argv[iarg],"--threads")) {
+      n_threads = atoi(argv[++iarg]);
+      if (n_threads < 1) {
+        printf ("error: --threads must be at least 1\n");
+        exit (1);
+      }
+    }
+    else if (strequal (argv[iarg],"--dominance=yes")) {
+      Ant::prune_dominated = true;
+    }
+    else if (strequal (argv[iarg],"--dominance=no")) {
+      Ant::prune_dominated = false;
+    }
+    else if (strequal (argv[iarg],"--parallel-trials")) {
+      n_parallel_trials = atoi(argv[++iarg]);
+      if (n_parallel_trials < 1) {
+        printf ("error: --parallel-trials must be at least 1\n");
+        exit (1);
+      }
+    }
+    else if (strequal (argv[iarg],"--islands")) {
+      n_islands = atoi(argv[++iarg]);
+      if (n_islands < 1) {
+        printf ("error: --islands must be at least 1\n");
+        exit (1);
+      }
+    }
+    else if (strequal (argv[iarg],"--migration-interval")) {
+      migration_interval = atoi(argv[++iarg]);
+      if (migration_interval < 1) {
+        printf ("error: --migration-interval must be at least 1\n");
+        exit (1);
+      }
+    }
+    else if (strequal (argv[iarg],"--migration=ring")) {
+      migration_topology = MIGRATION_RING;
+    }
+    else if (strequal (argv[iarg],"--migration=all")) {
+      migration_topology = MIGRATION_ALL;
+    }
+    else if (strequal (argv[iarg],"--listen")) {
+      listen_address = argv[++iarg];
+    }
+    else if (strequal (argv[iarg],"--peer")) {
+      peer_addresses.push_back (argv[++iarg]);
+    }
+    else if (strequal (argv[iarg],"--candidates")) {
+      candidate_list_size = atoi(argv[++iarg]);
+      if (candidate_list_size < 0) {
+        printf ("error: --candidates must be at least 0\n");
+        exit (1);
+      }
+    }
     else {
       printf ("error: unknown parameter: %s\n", argv[iarg]);
       printf ("use --help for usage.\n");
@@ -274,6 +462,11 @@ static void read_parameters(int argc, char **argv)
     exit (1);
   }
 
+  if (n_islands > 1 && n_parallel_trials > 1) {
+    printf ("error: --islands and --parallel-trials cannot be used together\n");
+    exit (1);
+  }
+
   if (time_limit == DBL_MAX && n_of_iter == INT_MAX) {
     printf ("error: no time limit or number of interations given."
             " Please specify:\n\n"
@@ -285,50 +478,464 @@ static void read_parameters(int argc, char **argv)
 }
 
 static void 
-print_trace_header (void)
+print_trace_header (FILE *trace)
 {
-  fprintf (trace_stream, "# Trial Iteration     Cost  Cviols     Time"
-           "  %8s  %8s\n", "TimeLS", "TimeSampling");
+  fprintf (trace, "# Trial Iteration     Cost  Cviols     Time"
+           "  %8s  %8s%s\n", "TimeLS", "TimeSampling",
+           (n_islands > 1) ? "  Island" : "");
 }
 static void 
-print_trace (Solution *s, int trial_counter, int iter, double time_taken)
+print_trace (const Solver &solver)
 {
-  fprintf (trace_stream, "%7d %9d %8.2f  %6d  %8.1f  %8.1f  %8.1f\n", 
-           trial_counter, iter,
-           double(s->cost()), s->constraint_violations(), time_taken,
-           time_localsearch, Ant::time_sampling);
+  Solution *s = solver.best_so_far;
+  if (n_islands > 1)
+    fprintf (solver.trace, "%7d %9d %8.2f  %6d  %8.1f  %8.1f  %8.1f  %6d\n",
+             solver.trial, solver.best_iter,
+             double(s->cost()), s->constraint_violations(), solver.best_time,
+             solver.time_localsearch, solver.time_sampling, solver.island);
+  else
+    fprintf (solver.trace, "%7d %9d %8.2f  %6d  %8.1f  %8.1f  %8.1f\n", 
+             solver.trial, solver.best_iter,
+             double(s->cost()), s->constraint_violations(), solver.best_time,
+             solver.time_localsearch, solver.time_sampling);
   //  s->print_one_line(trace_stream);
 }
 
 static void
-trial_begin (int trial_counter)
+trial_begin (FILE *out, FILE *trace, int trial_counter)
+{
+  fprintf (out, "# begin try %d\n", trial_counter);
+  print_trace_header (trace);
+}
+
+/* The island with the best solution, the first one if there are
+   ties.  */
+static const Solver &
+best_island (const vector<Solver*> &islands)
 {
-  printf ("# begin try %d\n", trial_counter);
-  print_trace_header();
+  size_t best = 0;
+  for (size_t j = 1; j < islands.size(); j++)
+    if (islands[j]->best_so_far->better_than (islands[best]->best_so_far))
+      best = j;
+  return *islands[best];
 }
 
+/* Report the solution and times of the best island, with the
+   evaluations and statistics of all islands added up.  */
 static void
-trial_end (int trial_counter, int best_iter, double best_time, 
-           int total_iter, double total_time)
+trial_end (FILE *out, const vector<Solver*> &islands)
 {
-  printf("%.2f\t%.1f\t", double(best_so_far->cost()), best_time);
-  best_so_far->print_one_line();
-  printf("#end try %d"
-         ", best_iterations = %d, best_time = %.1f"
-         ", evaluations = %u, iterations = %d, total_time = %.1f"
-         ", Time_init = %.1f, Time_ls = %.1f, Time_sampling = %.1f"
-         "\n",
-         trial_counter,
-         best_iter, best_time,
-         Solution::evaluations, total_iter, total_time,
-         time_init, time_localsearch, Ant::time_sampling);
+  const Solver &solver = best_island (islands);
+  unsigned int evaluations = 0;
+  unsigned long sampling_aborted = 0;
+  unsigned long sampling_steps_saved = 0;
+  unsigned long beam_dominated = 0;
+
+  for (size_t j = 0; j < islands.size(); j++) {
+    const Colony &colony = islands[j]->colony;
+    evaluations += colony.evaluations.load();
+    sampling_aborted += colony.sampling_aborted.load();
+    sampling_steps_saved += colony.sampling_steps_saved.load();
+    beam_dominated += colony.beam_dominated.load();
+  }
+
+  fprintf (out, "%.2f\t%.1f\t", double(solver.best_so_far->cost()),
+           solver.best_time);
+  solver.best_so_far->print_one_line (out);
+  fprintf (out, "#end try %d"
+                ", best_iterations = %d, best_time = %.1f"
+                ", evaluations = %u, iterations = %d, total_time = %.1f"
+                ", Time_init = %.1f, Time_ls = %.1f, Time_sampling = %.1f"
+                ", sampling_aborted = %lu, sampling_steps_saved = %lu"
+                ", beam_dominated = %lu",
+                solver.trial,
+                solver.best_iter, solver.best_time,
+                evaluations, solver.iter, solver.trial_time,
+                solver.time_init, solver.time_localsearch, solver.time_sampling,
+                sampling_aborted, sampling_steps_saved, beam_dominated);
+  if (islands.size() > 1)
+    fprintf (out, ", island = %d", solver.island);
+  fprintf (out, "\n");
 }
 
 
 
 
-static void
-UpdatePheromoneValues(bool bs_update, double cf)
+void check_valid (Solution *s, string ok, string fail)
+{
+  if (s->check_solution()) {
+    cerr << ok << endl;
+    s->print_verbose (stderr);
+  } else {
+    cerr << fail << endl;
+    s->print_verbose (stderr);
+  }
+}
+
+static void print_commandline (int argc, char *argv[])
+{
+  printf ("#");
+  for (int c = 0; c < argc; ++c)
+    printf (" %s", argv[c]);
+}
+
+static void print_parameters (const Instance &instance,
+                              int argc, char *argv[])
+{
+  printf ("# Beam-ACO ");
+  printf ("%s", program_invocation_short_name);
+  print_version ();
+  printf ("\n#\n");
+  print_commandline (argc, argv);
+  printf ("\n#\n");
+
+  instance.print_parameters ("#");
+
+  printf ("#\n");
+  printf ("# number trials : %d\n", n_of_trials);
+  printf ("# number iterations : %d\n", n_of_iter);
+  printf ("# time limit : %g\n", time_limit);
+  printf ("# time measured : %s\n",
+          (Timer::default_clock == Timer::WALL_TIME) ? "wall-clock time"
+          : (Timer::default_clock == Timer::THREAD_TIME)
+          ? "CPU time of each thread" : "CPU time of the process");
+  printf ("# seed : %u\n", random_seed);
+
+  printf ("#\n");
+
+  printf ("# number of ants : %d\n", n_of_ants);
+  printf ("# learning rate : %g\n", l_rate);
+  printf ("# determinism rate : %g\n", det_rate);
+  printf ("# heuristic type : %s\n", Solution::get_heuristic_type().c_str());
+  printf ("# localsearch : %s\n", Solution::get_localsearch_type().c_str());
+  printf ("# roulette wheel : %s\n", Ant::get_wheel_type().c_str());
+  printf ("#\n");
+
+  printf ("# beam width : %d\n", beam_width);
+  printf ("# mu : %g\n", mu);
+  printf ("# maximum children : %d\n", max_children);
+  printf ("# dominance pruning : %s\n", Ant::prune_dominated ? "yes" : "no");
+  printf ("# stochastic samples : %d\n", n_samples);
+  printf ("# sampling rate : %d (%d%%)\n", sample_rate, sample_percent);
+  printf ("# threads : %d\n", n_threads);
+  printf ("# parallel trials : %d\n", n_parallel_trials);
+  printf ("# islands : %d\n", n_islands);
+  printf ("# migration : %s every %d iterations\n",
+          (migration_topology == MIGRATION_ALL) ? "all" : "ring",
+          migration_interval);
+  printf ("# listen : %s\n",
+          listen_address.empty() ? "no" : listen_address.c_str());
+  printf ("# peers :");
+  for (size_t i = 0; i < peer_addresses.size(); i++)
+    printf (" %s", peer_addresses[i].c_str());
+  printf ("\n");
+  printf ("#\n");
+  printf ("\n");
+}
+
+Solver::Solver (const Instance *instance, Thread_Pool *thread_pool,
+                Peers *peers, Migration *migration, int island)
+  : colony (instance, thread_pool), trial (0), iter (1),
+    best_so_far (NULL), restart_best (NULL), iteration_best (NULL),
+    trace (trace_stream), peers (peers), migration (migration),
+    island (island), rng (0), constructions (n_of_ants),
+    ant_solution (n_of_ants), ant_time_localsearch (n_of_ants),
+    remote_best (NULL), remote_seen (0)
+{
+  colony.pheromone.set_parameters (l_rate, tau_min, tau_max);
+  for (int i = 0; i < n_of_ants; i++)
+    constructions[i].init (&colony);
+}
+
+Solver::~Solver ()
+{
+  delete best_so_far;
+  delete restart_best;
+  delete iteration_best;
+  delete remote_best;
+}
+
+/* Each trial has its own stream of random numbers, so that trials
+   may run in any order.  */
+void
+Solver::begin_trial (int trial, long seed)
+{
+  this->trial = trial;
+  timer.reset();
+
+  // initialization of the random generator
+  rng = Random (seed);
+  rng.next();
+
+  // 'iter' is the iteration counter
+  iter = 1;
+
+  /* if the three solutions that are used for updating the pheromone
+     values are initialized by a previous trial, we delete them */
+  delete best_so_far;
+  best_so_far = NULL;
+  delete restart_best;
+  restart_best = NULL;
+
+  /* for every trial we reinitialize the pheromone values to 0.5
+     each */
+  colony.pheromone.reset (0.5);
+
+  bs_update = false;
+  restart = false;
+  best_changed = false;
+  if (migration)
+    migrants_seen.assign (migration->size(), 0);
+  delete remote_best;
+  remote_best = NULL;
+  remote_seen = 0;
+  best_iter = 0;
+  best_time = 0.0;
+  time_localsearch = 0.0;
+  time_sampling = 0.0;
+  colony.reset_statistics ();
+
+  trial_time = timer.elapsed_time_virtual();
+  time_init = trial_time;
+}
+
+void
+Solver::build_ant (size_t i, long seed)
+{
+  Construction &construction = constructions[i];
+  construction.rng = Random (Random::derive_seed (seed, i));
+  construction.time_sampling = 0.0;
+  Ant ant (&construction);
+  Solution* newSol = NULL;
+  if (beam_width > 1) {
+    newSol = ant.beam_construct (det_rate, beam_width,
+                                 max_children,
+                                 to_choose,
+                                 n_samples, sample_rate);
+  } else {
+    newSol = ant.construct (det_rate);
+  }
+
+  ant_time_localsearch[i] = 0.0;
+  if (Solution::localsearch_type) {
+    Timer timer_localsearch (task_clock());
+    Solution *lsSol = newSol->localsearch();
+    //printf ("newSol:"); newSol->print_one_line();
+    //printf ("lsSol :"); lsSol->print_one_line();
+    while (lsSol->better_than (newSol)) {
+      delete newSol;
+      newSol = lsSol;
+      lsSol = newSol->localsearch();
+      //printf ("lsSol :"); lsSol->print_one_line();
+      // FIXME: Make localsearch_2opt_first work with asymmetric instances
+      if (colony.instance->is_symmetric) {
+          do {
+              Solution *lsSol2 = lsSol->localsearch_2opt_first();
+              if (!lsSol2->better_than(lsSol)) {
+                  delete lsSol2;
+                  break;
+              }
+              delete lsSol;
+              lsSol = lsSol2;
+          } while(true);
+      }
+    }
+    delete newSol;
+    newSol = lsSol;
+    ant_time_localsearch[i] = timer_localsearch.elapsed_time_virtual ();
+  }
+  ant_solution[i] = newSol;
+}
+
+void
+Solver::update_best_so_far (void)
+{
+  delete best_so_far;
+  best_so_far = iteration_best->clone();
+  best_iter = iter;
+  best_time = timer.elapsed_time_virtual();
+  best_changed = true;
+
+  print_trace (*this);
+
+  if (peers)
+    peers->send (trial, best_so_far->permutation);
+
+  DEBUG2 (check_valid (best_so_far, "best_so_far is valid",
+                       "best_so_far is NOT valid"));
+}
+
+/* One iteration of the algorithm: ants produce a solution each and
+   the pheromone values are updated.  */
+void
+Solver::iterate (void)
+{
+  delete iteration_best;
+  iteration_best = NULL;
+  double avg_cost = 0.0;
+  double avg_viols = 0.0;
+
+  /* Ant i uses the i-th stream derived from seed, and the ants are
+     compared in order below, so the result does not depend on the
+     number of threads.  */
+  long seed = rng.rand_int (INT_MAX);
+
+  /* A better tour received from other processes bounds the beam
+     searches of this iteration and competes with its ants.  */
+  bool remote_improved = (peers != NULL && receive_remote ());
+  for (int i = 0; i < n_of_ants; i++)
+    constructions[i].incumbent = remote_best;
+
+  /* With several ants, each one is built by a single thread of the
+     pool. The pheromone is shared, so its rows are brought up to date
+     first and then only read. With one ant, the threads are used
+     within its construction instead. The local search and sampling
+     times of an ant built in a task of the pool are CPU times of its
+     thread (see task_clock()).  */
+  if (n_of_ants > 1 && colony.thread_pool->size() > 1) {
+    colony.thread_pool->parallel_for (colony.instance->n, [&] (size_t k) {
+      colony.pheromone.row (k);
+    });
+    colony.thread_pool->parallel_for (n_of_ants, [&] (size_t i) {
+      build_ant (i, seed);
+    });
+  } else {
+    for (int i = 0; i < n_of_ants; i++)
+      build_ant (i, seed);
+  }
+
+  for (int i = 0; i < n_of_ants; i++) {
+    Solution *newSol = ant_solution[i];
+    time_localsearch += ant_time_localsearch[i];
+    time_sampling += constructions[i].time_sampling;
+    avg_cost = avg_cost + newSol->cost();
+    avg_viols = avg_viols + newSol->constraint_violations();
+    if (iteration_best == NULL) {
+      iteration_best = newSol;
+    }
+    else if (newSol->better_than (iteration_best)) {
+      delete iteration_best;
+      iteration_best = newSol;
+    }
+    else {
+      delete newSol;
+    }
+  }
+
+  avg_cost = avg_cost / double(n_of_ants);
+  avg_viols = avg_viols / double(n_of_ants);
+
+  if (remote_improved && remote_best->better_than (iteration_best)) {
+    delete iteration_best;
+    iteration_best = remote_best->clone();
+  }
+
+  bool exchange = (migration != NULL && iter % migration_interval == 0);
+  if (exchange)
+    receive_migrants ();
+
+  if (iter == 1) {
+    // if we are in the first iteration then we can initialize all
+    // the variables
+    restart_best = iteration_best->clone();
+    update_best_so_far ();
+  }
+  else if (restart) {
+    // if this is the first iteration after a restart, then we do
+    // the following:
+    restart = false;
+    delete restart_best;
+    restart_best = iteration_best->clone();
+
+    if (iteration_best->better_than(best_so_far)) {
+      update_best_so_far ();
+    }
+  }
+  else {
+    if (iteration_best->better_than (restart_best)) {
+      delete restart_best;
+      restart_best = iteration_best->clone();
+    }
+
+    if (iteration_best->better_than (best_so_far)) {
+      update_best_so_far();
+    }
+  }
+
+  // computation of the convergence factor
+  double cf = convergence_factor();
+  DEBUG2(cerr << "cf: " << cf << endl);
+
+  /* if the best_so_far solution was used for updating the
+     pheromone values and the convergence factor is greater than
+     0.99 we do a restart ... */
+  if (bs_update && (cf > 0.99)) {
+    bs_update = false;
+    restart = true;
+    colony.pheromone.reset (0.5);
+  }
+  else {
+    /* ... otherwise: if convergence factor is greater than 0.99
+       we use the best_so_far solution from now on for updating */
+    if (cf > 0.99)
+      bs_update = true;
+
+    update_pheromone (cf);
+  }
+
+  if (exchange && best_changed) {
+    migration->publish (island, best_so_far->permutation);
+    best_changed = false;
+  }
+
+  iter = iter + 1;
+  trial_time = timer.elapsed_time_virtual();
+}
+
+/* The tours that other islands published since the last exchange
+   compete with the ants of this iteration, so that a better one
+   becomes iteration_best and takes part in updating the pheromone and
+   the best solutions of this island.  */
+void
+Solver::receive_migrants (void)
+{
+  for (int from = 0; from < migration->size(); from++) {
+    if (!migration->receives (island, from)
+        || !migration->receive (from, migrant_tour, migrants_seen[from]))
+      continue;
+
+    Solution *migrant = new Solution (colony.instance, &colony.evaluations);
+    migrant->add (&migrant_tour[1]);
+    if (migrant->better_than (iteration_best)) {
+      delete iteration_best;
+      iteration_best = migrant;
+    } else {
+      delete migrant;
+    }
+  }
+}
+
+/* Keep the tour received from other processes if it is better than
+   the one kept before.  */
+bool
+Solver::receive_remote (void)
+{
+  if (!peers->receive (trial, migrant_tour, remote_seen))
+    return false;
+
+  Solution *remote = new Solution (colony.instance, &colony.evaluations);
+  remote->add (&migrant_tour[1]);
+  if (remote_best != NULL && !remote->better_than (remote_best)) {
+    delete remote;
+    return false;
+  }
+  delete remote_best;
+  remote_best = remote;
+  return true;
+}
+
+void
+Solver::update_pheromone (double cf)
 {
   /* i_weight, r_weight, g_weight are the weights of influence
      for updating the pheromone values they are set depending on
@@ -368,141 +975,120 @@ UpdatePheromoneValues(bool bs_update, double cf)
   }
   /* We specifiy vector d, and then we update the pheromone
      vector towards vector d depending on the learning rate
-     l_rate */
+     l_rate. d is zero except on the edges of the three solutions,
+     so it is stored as a list of (edge, weight) pairs.  */
 
   //cout << "before update" << endl;
-  int n = Solution::n;
+  int n = colony.instance->n;
 
-  double d[n][n];
-  for (int i = 0; i < n; i++) {
-    for (int j = 0; j < n; j++) {
-      d[i][j] = 0.0;
-    }
-  }
+  vector<pair<pair<int,int>, double> > &d = deposit;
+  d.clear();
 
   vector<int> &ib = iteration_best->permutation;
   vector<int> &rb = restart_best->permutation;
   vector<int> &bf = best_so_far->permutation;
 
   for (int i = 1; i < n; i++) {
-    d[ ib[i-1] ][ ib[i] ] += i_weight;
-    d[ rb[i-1] ][ rb[i] ] += r_weight;
-    d[ bf[i-1] ][ bf[i] ] += g_weight;
+    if (i_weight != 0.0)
+      d.push_back (make_pair (make_pair (ib[i-1], ib[i]), i_weight));
+    if (r_weight != 0.0)
+      d.push_back (make_pair (make_pair (rb[i-1], rb[i]), r_weight));
+    if (g_weight != 0.0)
+      d.push_back (make_pair (make_pair (bf[i-1], bf[i]), g_weight));
   }
 
-  vector<vector<double> > &ph = Ant::pheromone;
+  // Add up the weights of repeated edges in the order above.
+  stable_sort (d.begin(), d.end(), 
+               [] (const pair<pair<int,int>, double> &a,
+                   const pair<pair<int,int>, double> &b) {
+                 return a.first < b.first; });
+  size_t count = 0;
+  for (size_t k = 0; k < d.size(); k++) {
+    if (count > 0 and d[count-1].first == d[k].first)
+      d[count-1].second += d[k].second;
+    else
+      d[count++] = d[k];
+  }
+  d.resize (count);
 
-  for (int i = 0; i < n; i++) {
-    for (int j = 0; j < n; j++) {
-      ph[i][j] += l_rate * (d[i][j] - ph[i][j]);
-      if (ph[i][j] > tau_max) {
-        ph[i][j] = tau_max;
-      }
-      if (ph[i][j] < tau_min) {
-        ph[i][j] = tau_min;
-      }
-    }
+  Pheromone &ph = colony.pheromone;
+
+  // Updated values of the edges in d, computed before evaporation.
+  for (size_t k = 0; k < d.size(); k++) {
+    double p = ph.get (d[k].first.first, d[k].first.second);
+    p += l_rate * (d[k].second - p);
+    if (p > tau_max) p = tau_max;
+    if (p < tau_min) p = tau_min;
+    d[k].second = p;
   }
+
+  // Everywhere else, d is zero, so the pheromone just evaporates. Both
+  // are applied to each row when it is next read.
+  ph.evaporate (d);
 }
 
-/* The method computeConvergenceFactor computes the convergence factor
+/* The method convergence_factor computes the convergence factor
    cf, which gives an indication about the current state of the system
    in terms of its convergence */
 
-static double computeConvergenceFactor() {
-
-  double ret_val = 0.0;
-  int n = Solution::n;
+double
+Solver::convergence_factor (void)
+{
+  int n = colony.instance->n;
   int count = n * n;
 
-  for (int i = 0; i < n; i++) {
-    for (int j = 0; j < n; j++) {
-      //      count++;
-      ret_val = ret_val + max (tau_max - Ant::pheromone[i][j],
-                               Ant::pheromone[i][j] - tau_min);
-    }
-  }
+  double ret_val = colony.pheromone.convergence_sum();
   ret_val = ret_val / (count * (tau_max - tau_min));
   ret_val = (ret_val - 0.5) * 2.0;
   return ret_val;
 }
 
-void check_valid (Solution *s, string ok, string fail)
-{
-  if (s->check_solution()) {
-    cerr << ok << endl;
-    s->print_verbose (stderr);
-  } else {
-    cerr << fail << endl;
-    s->print_verbose (stderr);
-  }
-}
+/* Run one trial with its own seeds, writing its trace to trace and
+   its results to out. Island j uses the stream of trial
+   trial + j * n_of_trials, so streams are never shared.
 
-static void print_commandline (int argc, char *argv[])
+   Each island runs in a thread of its own, started here and joined
+   before the results are reported, so islands always run at the same
+   time. Each island starts its trial, and so its timer, in that
+   thread, because with per-thread timers it must be reset and read in
+   the same thread.  */
+static void
+run_island (Solver &solver, int trial, int j, FILE *trace)
 {
-  printf ("#");
-  for (int c = 0; c < argc; ++c)
-    printf (" %s", argv[c]);
+  solver.trace = trace;
+  solver.begin_trial (trial, Random::derive_seed
+                      (random_seed, trial + j * n_of_trials));
+  /* this is the main loop of the algorithm. At each iteration ants
+     produce a solution each and the pheromone values are
+     updated. */
+  while (!solver.finished())
+    solver.iterate();
 }
 
-static void print_parameters (int argc, char *argv[])
+static void
+run_trial (const vector<Solver*> &islands, int trial, FILE *out, FILE *trace)
 {
-  printf ("# Beam-ACO ");
-  printf ("%s", program_invocation_short_name);
-  print_version ();
-  printf ("\n#\n");
-  print_commandline (argc, argv);
-  printf ("\n#\n");
-
-  Solution::print_parameters ("#");
-
-  printf ("#\n");
-  printf ("# number trials : %d\n", n_of_trials);
-  printf ("# number iterations : %d\n", n_of_iter);
-  printf ("# time limit : %g\n", time_limit);
-  printf ("# seed : %u\n", random_seed);
-
-  printf ("#\n");
+  if (islands[0]->migration)
+    islands[0]->migration->clear();
 
-  printf ("# number of ants : %d\n", n_of_ants);
-  printf ("# learning rate : %g\n", l_rate);
-  printf ("# determinism rate : %g\n", det_rate);
-  printf ("# heuristic type : %s\n", Solution::get_heuristic_type().c_str());
-  printf ("# localsearch : %s\n", Solution::get_localsearch_type().c_str());
-  printf ("#\n");
+  if (islands.size() == 1)
+    run_island (*islands[0], trial, 0, trace);
+  else {
+    vector<thread> threads;
+    for (size_t j = 0; j < islands.size(); j++)
+      threads.push_back (thread (run_island, ref (*islands[j]), trial,
+                                 int (j), trace));
+    for (size_t j = 0; j < threads.size(); j++)
+      threads[j].join();
+  }
 
-  printf ("# beam width : %d\n", beam_width);
-  printf ("# mu : %g\n", mu);
-  printf ("# maximum children : %d\n", max_children);
-  printf ("# stochastic samples : %d\n", n_samples);
-  printf ("# sampling rate : %d (%d%%)\n", sample_rate, sample_percent);
-  printf ("#\n");
-  printf ("\n");
+  trial_end (out, islands);
 }
 
-#define update_best_so_far()                                    \
-do {                                                            \
-  delete best_so_far;                                           \
-  best_so_far = iteration_best->clone();                        \
-  time_taken = timer.elapsed_time_virtual();                    \
-                                                                \
-  print_trace (best_so_far, trial_counter, iter, time_taken);   \
-                                                                \
-  DEBUG2 (check_valid (best_so_far, "best_so_far is valid",     \
-               "best_so_far is NOT valid"));                    \
-                                                                \
-  results[trial_counter-1] = best_so_far->cost();               \
-  viols[trial_counter-1] = best_so_far->constraint_violations();\
-  times_best_found[trial_counter-1] = time_taken;               \
-  iter_best_found[trial_counter-1] = iter;                      \
-} while(0)
-
 /* 'main' is the main body of the program */
 
 int main( int argc, char **argv )
 {
-  double trial_time;
-
   // upon declaration of a variable of type 'Timer' the time is running ...
   Timer timer;
   
@@ -513,234 +1099,132 @@ int main( int argc, char **argv )
 
   cout.precision (10);
 
-  // rnd: a random generator
-  Random rnd(random_seed);
-  // initialization of the random generator
-  rnd.next();
-  // rnd = new Random (random_seed);
-  // rnd->next();
-
-  Ant::Init(input_filename, &rnd);
-
-  int to_choose = int(double(beam_width) * mu);
-  sample_rate = int((double(sample_percent) * (Solution::n - 1) / 100.0) + 0.5) + 1;
+  // reading the problem instance
+  Instance instance (input_filename, candidate_list_size);
+
+  /* Trials run at the same time use the pool, and then whatever they
+     would run on the pool runs serially in their own thread. Islands
+     have their own threads (see run_trial()) and share a pool without
+     workers, so they also run everything serially.  */
+  if (n_parallel_trials > n_of_trials)
+    n_parallel_trials = n_of_trials;
+  Thread_Pool thread_pool (n_parallel_trials > 1 ? n_parallel_trials
+                           : n_islands > 1 ? 1 : n_threads);
+
+  /* A trial or island that runs in a single thread is timed with the
+     CPU time of that thread. A solver that spreads its work over the
+     threads of the pool is timed with the wall-clock time, as the CPU
+     time of the process would add up the time of all threads.  */
+  if (n_parallel_trials > 1 || n_islands > 1)
+    Timer::default_clock = Timer::THREAD_TIME;
+  else if (thread_pool.size() > 1)
+    Timer::default_clock = Timer::WALL_TIME;
+
+  to_choose = int(double(beam_width) * mu);
+  sample_rate = int((double(sample_percent) * (instance.n - 1) / 100.0) + 0.5) + 1;
 
   //  fprintf (stderr, "too_choose = %d, sample_rate = %d\n",
   //           to_choose, sample_rate);
 
-  print_parameters (argc, argv);
+  print_parameters (instance, argc, argv);
+
+  Peers *peers = NULL;
+  if (!listen_address.empty() || !peer_addresses.empty())
+    peers = new Peers (&instance, n_of_trials, listen_address,
+                       peer_addresses);
 
   /* The following variables are for collecting statistics on several
      trials.  */
   Solution* best = NULL;
-  vector<double> results;
-  vector<double> viols;
-  vector<double> times_best_found;
-  vector<int> iter_best_found;
+  vector<double> results (n_of_trials);
+  vector<double> viols (n_of_trials);
+  vector<double> times_best_found (n_of_trials);
+  vector<int> iter_best_found (n_of_trials);
+  vector<Solution*> trial_best (n_of_trials);
 
   fprintf (trace_stream, "# Initialization Time %g\n", 
            timer.elapsed_time_virtual());
 
-  /* The following for loop is for controlling the number of trials as
-     specified by command line parameters.  */
-  for (int trial_counter = 1; trial_counter <= n_of_trials; trial_counter++) {
-
-    trial_begin (trial_counter);
-
-    timer.reset();
-
-    // 'iter' is the iteration counter
-    int iter = 1;
-
-    /* if the three solutions that are used for updating the pheromone
-       values are initialized by a previous trial, we delete them */
-    if (best_so_far != NULL) {
-      delete best_so_far;
-    }
-    best_so_far = NULL;
-
-    if (restart_best != NULL) {
-      delete restart_best;
+  if (n_parallel_trials == 1) {
+    /* Each island runs in a single thread, so its times are the CPU
+       times of that thread.  */
+    Migration *migration = NULL;
+    if (n_islands > 1) {
+      migration = new Migration (n_islands, instance.n, migration_topology);
     }
-    restart_best = NULL;
-
-    /* for every trial we reinitialize the pheromone values to 0.5
-       each */
-    if (trial_counter == 1) {
-      Ant::initUniformPheromoneValues();
+    vector<Solver*> islands (n_islands);
+    for (int j = 0; j < n_islands; j++)
+      islands[j] = new Solver (&instance, &thread_pool, peers, migration, j);
+
+    /* The following for loop is for controlling the number of trials
+       as specified by command line parameters.  */
+    for (int i = 0; i < n_of_trials; i++) {
+      trial_begin (stdout, trace_stream, i + 1);
+      run_trial (islands, i + 1, stdout, trace_stream);
+      const Solver &solver = best_island (islands);
+      trial_best[i] = solver.best_so_far->clone();
+      times_best_found[i] = solver.best_time;
+      iter_best_found[i] = solver.best_iter;
     }
-    else {
-      Ant::resetUniformPheromoneValues();
-    }
-
-    /* the following four variable are for controlling the update and
-       the restart of the algorithm cf is the convergence factor
-       bs_update regulates the use of the best_so_far solution for
-       updating program_stop controls the termination of a trial
-       restart controls the restart mechanism of the algorithm
-       time_taken is a variable for keeping the CPU times when
-       checked */
-    bool bs_update = false;
-    bool restart = false;
-    time_taken = 0.0;
-    time_localsearch = 0.0;
-    time_init = 0.0;
-    Ant::time_sampling = 0.0;
-    Solution::evaluations = 0;
-
-    /* this is the main loop of the algorithm. At each iteration ants
-       produce a solution each and the pheromone values are
-       updated. */
-    trial_time = timer.elapsed_time_virtual();
-    time_init = trial_time;
-
-    while (trial_time < time_limit
-           && iter <= n_of_iter) {
-
-      if (iteration_best != NULL) {
-        delete iteration_best;
-      }
-      iteration_best = NULL;
-      double avg_cost = 0.0;
-      double avg_viols = 0.0;
-
-      // our ant constructs a number of <n_of_ants> solutions
-      for (int i = 0; i < n_of_ants; i++) {
-        Ant ant;
-        Solution* newSol = NULL;
-        if (beam_width > 1) {
-          newSol = ant.beam_construct (det_rate, beam_width,
-                                       max_children,
-                                       to_choose,
-                                       n_samples, sample_rate);
-        } else {
-	  newSol = ant.construct (det_rate);
-        }
-
-        if (Solution::localsearch_type) {
-          double time_localsearch_stop = timer.elapsed_time_virtual ();
-          Solution *lsSol = newSol->localsearch();
-          //printf ("newSol:"); newSol->print_one_line();
-          //printf ("lsSol :"); lsSol->print_one_line();
-          while (lsSol->better_than (newSol)) {
-            delete newSol;
-            newSol = lsSol;
-            lsSol = newSol->localsearch();
-            //printf ("lsSol :"); lsSol->print_one_line();
-            // FIXME: Make localsearch_2opt_first work with asymmetric instances
-            if (Solution::is_symmetric) {
-                do {
-                    Solution *lsSol2 = lsSol->localsearch_2opt_first();
-                    if (!lsSol2->better_than(lsSol)) {
-                        delete lsSol2;
-                        break;
-                    }
-                    delete lsSol;
-                    lsSol = lsSol2;
-                } while(true);
-            }
-          }
-          delete newSol;
-          newSol = lsSol;
-          time_localsearch += timer.elapsed_time_virtual () - time_localsearch_stop;
-        }
-
-        avg_cost = avg_cost + newSol->cost();
-        avg_viols = avg_viols + newSol->constraint_violations();
-        if (iteration_best == NULL) {
-          iteration_best = newSol;
-        }
-        else if (newSol->better_than (iteration_best)) {
-          delete iteration_best;
-          iteration_best = newSol;
-        }
-        else {
-          delete newSol;
-        }
-      }
-
-      avg_cost = avg_cost / double(n_of_ants);
-      avg_viols = avg_viols / double(n_of_ants);
-
-      if (iter == 1) {
-	// if we are in the first iteration then we can initialize all
-	// the variables
-	if (best_so_far != NULL) {
-	  delete best_so_far;
-	}
-        best_so_far = iteration_best->clone();
-	if (restart_best != NULL) {
-	  delete restart_best;
-	}
-	restart_best = iteration_best->clone();
-	time_taken = timer.elapsed_time (Timer::VIRTUAL);
-	results.push_back (best_so_far->cost());
-        viols.push_back (best_so_far->constraint_violations());
-	times_best_found.push_back (time_taken);
-	iter_best_found.push_back (iter);
-
-        print_trace (best_so_far, trial_counter, iter, time_taken);
-
-        DEBUG2 (check_valid (best_so_far, "best_so_far is valid",
-                             "best_so_far is NOT valid"));
-      }
-      else if (restart) {
-        // if this is the first iteration after a restart, then we do
-        // the following:
-        restart = false;
-        delete restart_best;
-        restart_best = iteration_best->clone();
-
-        if (iteration_best->better_than(best_so_far)) {
-          update_best_so_far ();
-        }
-      }
-      else {
-        if (iteration_best->better_than (restart_best)) {
-          delete restart_best;
-          restart_best = iteration_best->clone();
-        }
-
-        if (iteration_best->better_than (best_so_far)) {
-          update_best_so_far();
-        }
-      }
 
-      if (best == NULL) {
-        best = best_so_far->clone();
-      }
-      else if (best_so_far->better_than(best)) {
-        delete best;
-        best = best_so_far->clone();
+    for (int j = 0; j < n_islands; j++)
+      delete islands[j];
+    delete migration;
+  } else {
+    /* Each trial runs in one thread, so its times are the CPU times of
+       that thread. Its output is kept in memory and printed once the
+       trials before it have been printed, so it appears in the same
+       order as if the trials had run one after the other.  */
+    vector<char*> out_text (n_of_trials), trace_text (n_of_trials);
+    vector<size_t> out_size (n_of_trials), trace_size (n_of_trials);
+    vector<bool> done (n_of_trials, false);
+    int printed = 0;
+    mutex output_lock;
+
+    thread_pool.parallel_for (n_of_trials, [&] (size_t i) {
+      FILE *out = open_memstream (&out_text[i], &out_size[i]);
+      FILE *trace = open_memstream (&trace_text[i], &trace_size[i]);
+      if (out == NULL or trace == NULL) {
+        perror ("open_memstream");
+        exit (1);
       }
-
-      // computation of the convergence factor
-      double cf = computeConvergenceFactor();
-      DEBUG2(cerr << "cf: " << cf << endl);
-
-      /* if the best_so_far solution was used for updating the
-         pheromone values and the convergence factor is greater than
-         0.99 we do a restart ... */
-      if (bs_update && (cf > 0.99)) {
-	bs_update = false;
-	restart = true;
-	Ant::resetUniformPheromoneValues();
+      Solver solver (&instance, &thread_pool, peers);
+      run_trial (vector<Solver*> (1, &solver), i + 1, out, trace);
+      fclose (out);
+      fclose (trace);
+      trial_best[i] = solver.best_so_far->clone();
+      times_best_found[i] = solver.best_time;
+      iter_best_found[i] = solver.best_iter;
+
+      lock_guard<mutex> guard (output_lock);
+      done[i] = true;
+      for (; printed < n_of_trials and done[printed]; printed++) {
+        trial_begin (stdout, trace_stream, printed + 1);
+        fflush (stdout);
+        fwrite (trace_text[printed], 1, trace_size[printed], trace_stream);
+        fflush (trace_stream);
+        fwrite (out_text[printed], 1, out_size[printed], stdout);
+        fflush (stdout);
+        free (out_text[printed]);
+        free (trace_text[printed]);
       }
-      else {
-        /* ... otherwise: if convergence factor is greater than 0.99
-           we use the best_so_far solution from now on for updating */
-        if (cf > 0.99)
-          bs_update = true;
+    });
+  }
 
-        UpdatePheromoneValues (bs_update, cf);
-      }
+  for (int i = 0; i < n_of_trials; i++) {
+    results[i] = trial_best[i]->cost();
+    viols[i] = trial_best[i]->constraint_violations();
 
-      iter = iter + 1;
-      trial_time = timer.elapsed_time_virtual();
+    if (best == NULL) {
+      best = trial_best[i];
+    }
+    else if (trial_best[i]->better_than(best)) {
+      delete best;
+      best = trial_best[i];
+    }
+    else {
+      delete trial_best[i];
     }
-
-    trial_end (trial_counter, iter_best_found[trial_counter-1],
-               times_best_found[trial_counter-1], iter, trial_time);
   }
 
   /* The following lines are for writing the statistics about the
@@ -789,6 +1273,7 @@ int main( int argc, char **argv )
          r_mean, v_mean, rsd, vsd, t_mean, tsd);
 
   delete best;
+  delete peers;
 
   return 0;
 }
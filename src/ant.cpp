@@ -30,110 +30,272 @@
 #include "ant.h"
 #include "Timer.h"
 
-vector<vector<double> > Ant::pheromone;
-vector<vector<double> > Ant::total;
-Random *Ant::rng = 0;
-double Ant::time_sampling;
+wheel_type_t Ant::wheel_type = WHEEL_LINEAR;
+bool Ant::prune_dominated = false;
 
-void matrix_fill(vector<vector<double> > &m, int n, double value)
+Colony::Colony (const Instance *instance, Thread_Pool *thread_pool)
+  : instance (instance), thread_pool (thread_pool)
 {
-    for (int i = 0; i < n; i++)
-        for (int j = 0; j < n; j++)
-            m[i][j] = value;
+  pheromone.init (instance->n, 0.5);
+  reset_statistics ();
 }
-/* The method initUniformPheromoneValues initializes all the pheromone
-   values to 0.5 */
-void Ant::initUniformPheromoneValues() 
+
+void
+Colony::reset_statistics (void)
 {
-    matrix_fill(Ant::pheromone, Solution::n, 0.5);
+  evaluations = 0;
+  sampling_aborted = 0;
+  sampling_steps_saved = 0;
+  beam_dominated = 0;
 }
 
-/* The method resetUniformPheromoneValues resets all the pheromone
-   values to 0.5 */
-
-void Ant::resetUniformPheromoneValues() 
+void
+Construction::init (Colony *colony)
 {
-    matrix_fill(Ant::pheromone, Solution::n, 0.5);
+  int n = colony->instance->n;
+
+  this->colony = colony;
+  total = Matrix<double> (n, n);
+  if (Ant::wheel_type == WHEEL_ALIAS) {
+    alias_prob = Matrix<double> (n, n);
+    alias_node = Matrix<int> (n, n);
+  }
 }
 
+/* The loops below visit every node and select values with the mask
+   of assigned nodes instead of skipping them, so that they can be
+   vectorised.  */
 void Ant::update_probs (int added) 
 {
-  basesum = 0.0;
-  // ??? We currently have to enforce both _tau == 0.0 and
-  // node_assigned[i] == true for assigned nodes. It would be better
-  // to choose one approach and use only that consistently.
-  probs[added] = 0.0;
-
-  for (int k = 0, inode = 0; k < nodes_available; k++) {
-    while (node_assigned[++inode]);
-    probs[inode] = total[added][inode];
-    basesum += probs[inode];
+  const double *row = construction->total[added];
+  const unsigned char *assigned = &node_assigned[0];
+  double *p = &probs[0];
+  const int n = instance->n;
+  double sum = 0.0;
+
+  for (int i = 0; i < n; i++) {
+    double v = assigned[i] ? 0.0 : row[i];
+    p[i] = v;
+    sum += v;
   }
+  basesum = sum;
   assert (probs[added] == 0.0);
   assert (isfinite (basesum));
 }
 
-int Ant::maximum_prob (void) const
+/* First unassigned node with the largest positive value in row last of
+   total, or -1 if there is none.  */
+int Ant::maximum_prob (int last) const
 {
-  int max_node = -1;
+  const double *row = construction->total[last];
+  const unsigned char *assigned = &node_assigned[0];
+  const int n = instance->n;
   double max_prob = 0.0;
 
   for (int i = 1; i < n; i++) {
-    if (max_prob < probs[i]) {
-      max_prob = probs[i];
-      max_node = i;
+    double v = assigned[i] ? 0.0 : row[i];
+    max_prob = (max_prob < v) ? v : max_prob;
+  }
+  if (max_prob == 0.0)
+    return -1;
+
+  int i = 1;
+  while (assigned[i] or row[i] != max_prob)
+    i++;
+  return i;
+}
+
+string
+Ant::get_wheel_type(void)
+{
+  switch (wheel_type) {
+    case WHEEL_LINEAR: return "linear";
+    case WHEEL_ALIAS:  return "alias";
+    default: abort();
+  }
+}
+
+/* Build the alias table of row k of total (Vose's method).  */
+void
+Ant::build_alias_table (int k) const
+{
+  static thread_local vector<double> scaled;
+  static thread_local vector<int> small, large;
+  const int n = instance->n;
+  const double *total = construction->total[k];
+  double *prob = construction->alias_prob[k];
+  int *alias = construction->alias_node[k];
+
+  double sum = 0.0;
+  for (int j = 0; j < n; j++)
+    sum += total[j];
+
+  scaled.resize (n);
+  small.clear();
+  large.clear();
+  for (int j = 0; j < n; j++) {
+    scaled[j] = (sum > 0.0) ? total[j] * n / sum : 0.0;
+    if (scaled[j] < 1.0)
+      small.push_back (j);
+    else
+      large.push_back (j);
+  }
+
+  while (!small.empty() && !large.empty()) {
+    int s = small.back(); small.pop_back();
+    int l = large.back();
+    prob[s] = scaled[s];
+    alias[s] = l;
+    scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+    if (scaled[l] < 1.0) {
+      large.pop_back();
+      small.push_back (l);
     }
   }
-  return max_node;
+  // Whatever is left has scaled probability 1 up to rounding.
+  for (size_t i = 0; i < large.size(); i++) {
+    prob[large[i]] = 1.0;
+    alias[large[i]] = large[i];
+  }
+  for (size_t i = 0; i < small.size(); i++) {
+    prob[small[i]] = 1.0;
+    alias[small[i]] = small[i];
+  }
 }
 
+/* Choose a node after last with probability proportional to
+   total[last][node] by drawing from the alias table of the row and
+   rejecting assigned nodes. Return -1 if too many draws are rejected.
+   Since each accepted draw follows the right distribution, falling
+   back to random_wheel afterwards does not bias the choice.  */
 int
-Ant::construction_step (int last, double det_rate)
+Ant::alias_wheel (int last, Random *r) const
 {
-  int node;
+  const int max_tries = 8;
+  const int n = instance->n;
+  const double *prob = construction->alias_prob[last];
+  const int *alias = construction->alias_node[last];
+  const double *row = construction->total[last];
+
+  for (int tries = 0; tries < max_tries; tries++) {
+    double u = r->next() * n;
+    int j = int(u);
+    if (j >= n) j = n - 1;
+    int node = (u - j < prob[j]) ? j : alias[j];
+    // The test on total guards against rounding in the table.
+    if (!node_assigned[node] && row[node] > 0.0)
+      return node;
+  }
+  return -1;
+}
 
-  update_probs (last);
-  if (det_rate >= 1.0 or (det_rate > 0.0  and rng->next() < det_rate)) 
-    node = maximum_prob ();
-  else
-    node = random_wheel ();
+/* Choose the next node after last among its candidates that can still
+   be reached within their time window, with probability proportional
+   to total or, if det, the one with the largest value. Return -1 if
+   there is none, so that the caller falls back to all unassigned
+   nodes.  */
+int
+Ant::candidate_step (int last, bool det, Random *r) const
+{
+  static thread_local vector<int> cand;
+  int count = feasible_candidates (last, cand);
+  const double *row = construction->total[last];
+
+  if (det) {
+    int node = -1;
+    double max_prob = 0.0;
+    for (int k = 0; k < count; k++) {
+      if (max_prob < row[cand[k]]) {
+        max_prob = row[cand[k]];
+        node = cand[k];
+      }
+    }
+    return node;
+  }
+
+  double sum = 0.0;
+  for (int k = 0; k < count; k++)
+    sum += row[cand[k]];
+  if (sum <= 0.0)
+    return -1;
+
+  double rand = r->next() * sum;
+  double wheel = 0.0;
+  int node = -1;
+  for (int k = 0; k < count; k++) {
+    if (row[cand[k]] <= 0.0) continue;
+    node = cand[k];
+    wheel += row[node];
+    if (rand < wheel) break;
+  }
+  return node;
+}
 
+int
+Ant::construction_step (int last, double det_rate, Random *r,
+                        unsigned int &count)
+{
+  bool det = (det_rate >= 1.0 or (det_rate > 0.0  and r->next() < det_rate));
+  int node = (instance->candidate_list_size > 0) ? candidate_step (last, det, r) : -1;
+
+  if (node < 0) {
+    if (det) {
+      node = maximum_prob (last);
+    } else {
+      node = (wheel_type == WHEEL_ALIAS) ? alias_wheel (last, r) : -1;
+      if (node < 0) {
+        update_probs (last);
+        node = random_wheel (r);
+      }
+    }
+  }
   DEBUG2 (fprintf (stderr, " %d", node));
 
   assert (node >= 0); // Negative means not found.
 
-  add (last, node);
+  count += append (last, node);
   return node;
 }
 
 void
 Ant::precompute_total (void)
 {
-  for (int k = 0; k < n; k++) {
-    for (int j = 0; j < n; j++) {
-      total[k][j] = pheromone[k][j] * heuristic_information (k, j);
-    }
+  const hinfo_weights_t &w = construction->weights;
+  Matrix<double> &total = construction->total;
+  Pheromone &pheromone = construction->colony->pheromone;
+
+  // Pending evaporation is applied to each row as it is read here.
+  for (int k = 0; k < instance->n; k++)
+    instance->heuristic_information_times (w, k, pheromone.row (k), total[k]);
+  if (wheel_type == WHEEL_ALIAS) {
+    Thread_Pool *thread_pool = construction->colony->thread_pool;
+    thread_pool->parallel_for (instance->n, [this] (size_t k) {
+      build_alias_table (k);
+    });
   }
 }
 
 Solution* 
 Ant::construct(double det_rate) 
 {
-  randomize_hinfo (rng);
+  Random *rng = &construction->rng;
+  construction->weights = random_hinfo_weights (rng);
   precompute_total ();
   int last = 0;
+  unsigned int count = 0;
 
   do {
-    last = construction_step (last, det_rate);
+    last = construction_step (last, det_rate, rng, count);
   } while (nodes_available);
+  *evaluations += count;
 
   Solution *solution = this;
   return solution->clone();  
 }
 
-int Ant::random_wheel ()
+int Ant::random_wheel (Random *r)
 {
-  double rand = rng->next() * basesum;
+  double rand = r->next() * basesum;
   int i = 1;
   double wheel = probs[i];
   
@@ -148,16 +310,36 @@ int Ant::random_wheel ()
   }
   
   assert (i > 0);
-  assert (i < n);
+  assert (i < instance->n);
   assert (!node_assigned[i]);
   assert (probs[i] > 0.0);
   return i;
 }
 
+/* Is the complete solution a better sample than b?  */
+static inline bool
+sample_better (const Ant &a, const Ant &b)
+{
+  return (a.constraint_violations() < b.constraint_violations()
+          or (a.constraint_violations() == b.constraint_violations()
+              and a.cost() < b.cost()));
+}
+
+/* Can the partial solution a only be completed into a solution worse
+   than b? Neither constraint violations nor cost decrease as nodes are
+   added.  */
+static inline bool
+cannot_improve (const Ant &a, const Ant &b)
+{
+  return (a.constraint_violations() > b.constraint_violations()
+          or (a.constraint_violations() == b.constraint_violations()
+              and a.cost() > b.cost()));
+}
+
 /* Take the current solution and generate complete solutions sampling
-   from current pheromone values. Calculate lower bounds for
-   constraint violations and cost of the solution.  */
-void Ant::complete (double det_rate)
+   from current pheromone values. If bound is not NULL, stop and return
+   false as soon as the solution cannot become better than bound.  */
+bool Ant::complete (double det_rate, Random *r, const Ant *bound)
 {
   int last = permutation.back();
 
@@ -168,38 +350,44 @@ void Ant::complete (double det_rate)
           fprintf (stderr, ":")
           );
 
+  unsigned int count = 0;
+
   while (nodes_available) {
-    last = construction_step (last, det_rate);
+    if (bound and cannot_improve (*this, *bound)) {
+      DEBUG3 (fprintf (stderr, " aborted (%d left)\n", nodes_available));
+      *evaluations += count;
+      return false;
+    }
+    last = construction_step (last, det_rate, r, count);
   }
+  *evaluations += count;
 
   DEBUG3 (fprintf (stderr, " %d\n", permutation.back()));
   assert (check_solution());
+  return true;
 }
 
+/* Take the current solution and generate complete solutions sampling
+   from current pheromone values. Calculate lower bounds for
+   constraint violations and cost of the solution.  */
 Ant *
-Ant::stochastic_sampling (int n_samples, double det_rate)
+Ant::stochastic_sampling (int n_samples, double det_rate, long seed)
 {
-  Timer timer_sampling;
-
-  _lower_bound = -1;
-  _lower_bound_constraint_violations = -1;
-  int &_cviols = _lower_bound_constraint_violations;
-
-  Ant best;
+  Ant best (construction);
+  Ant sol (construction);
 
   if (nodes_available <= 3) {
     int k = 0;
     int inode = 0;
-    int p[nodes_available];
+    int p[3];
     for (k = 0; k < nodes_available; k++) {
       while (node_assigned[++inode]);
       p[k] = inode;
     }
 
+    bool first = true;
     do {
-
-      Ant sol = *this;
-
+      sol = *this;
       sol.add (p);
 
       DEBUG3 (fprintf (stderr, "Permutation: ");
@@ -212,47 +400,38 @@ Ant::stochastic_sampling (int n_samples, double det_rate)
                        double(sol.cost()), sol.constraint_violations());
               );
 
-      if (_lower_bound == -1) {
-        _lower_bound = sol.cost();
-        _cviols = sol.constraint_violations();
-        best = sol;
-      }
-      else if (sol.constraint_violations() < _cviols
-               or (sol.constraint_violations() == _cviols 
-                   and sol.cost() < _lower_bound)) {
-        _lower_bound = sol.cost();
-        _cviols = sol.constraint_violations();
-        best = sol;
+      if (first or sample_better (sol, best)) {
+        std::swap (best, sol);
+        first = false;
       }
     } while (next_permutation (p, p + nodes_available));
 
-    goto finish;
-  }
-
-  for (int i = 0; i < n_samples; i++) {
-
-    Ant sol = *this;
-    sol.complete (det_rate);
-
-    if (_lower_bound == -1) {
-      _lower_bound = sol.cost();
-      _cviols = sol.constraint_violations();
-      best = sol;
-    }
-    else if (sol.constraint_violations() < _cviols
-             || (sol.constraint_violations() == _cviols 
-                 && sol.cost() < _lower_bound)) {
-      _lower_bound = sol.cost();
-      _cviols = sol.constraint_violations();
-      best = sol;
+  } else {
+    // A sample that cannot become strictly better than the best sample
+    // so far would not be chosen, so it is abandoned.
+    unsigned long aborted = 0;
+    unsigned long steps_saved = 0;
+
+    for (int i = 0; i < n_samples; i++) {
+      Random r (Random::derive_seed (seed, i));
+      sol = *this;
+      if (not sol.complete (det_rate, &r, (i == 0) ? NULL : &best)) {
+        aborted++;
+        steps_saved += sol.nodes_available;
+        continue;
+      }
+      if (i == 0 or sample_better (sol, best))
+        std::swap (best, sol);
     }
-
-    DEBUG3 (fprintf (stderr, "_lower_bound = %g, _cviols = %d\n", 
-                     double(_lower_bound), _cviols));
+    construction->colony->sampling_aborted += aborted;
+    construction->colony->sampling_steps_saved += steps_saved;
   }
 
- finish:
-  time_sampling += timer_sampling.elapsed_time_virtual();
+  _lower_bound = best.cost();
+  _lower_bound_constraint_violations = best.constraint_violations();
+
+  DEBUG3 (fprintf (stderr, "_lower_bound = %g, _cviols = %d\n", 
+                   double(_lower_bound), _lower_bound_constraint_violations));
   return best.clone();
 }
 
@@ -283,66 +462,104 @@ Ant::beam_construct(double det_rate,
                     int n_samples, int sample_rate) 
 {
   Beam beam;
+  Beam_Pool pool;
   Ant *best = NULL;
   int beam_depth = 0;
+  Random *rng = &construction->rng;
 
-  randomize_hinfo (rng);
+  construction->weights = random_hinfo_weights (rng);
   precompute_total ();
+
+  // The incumbent bounds the beam as if it had been sampled.
+  if (construction->incumbent != NULL) {
+    best = new Ant (construction);
+    static_cast<Solution &> (*best) = *construction->incumbent;
+  }
+
   // Initialize the root of the beam with an empty solution.
-  Beam_Element * beam_root = new Beam_Element ();
+  Beam_Element * beam_root = new Beam_Element (construction);
+  Thread_Pool *thread_pool = construction->colony->thread_pool;
   beam.push_back (beam_root);
 
   DEBUG2 (fprintf (stderr, "Beam construct:\n"));
 
+  // Candidate children of the current beam and the beam built from
+  // them. Reused across depths.
+  Beam_Children children;
+  Beam new_beam;
+  // The children of beam[k] are stored in [first[k], first[k+1]).
+  vector<size_t> first;
+  // Per beam element sums, added up in beam order so that the result
+  // does not depend on the number of threads.
+  vector<double> partial_sum;
+  // Best sample of each element of new_beam, if it was sampled.
+  vector<Ant*> sampled;
+
   while (true) {
-    Beam children;
-    
-    for (Beam::iterator beam_it = beam.begin(); 
-         beam_it != beam.end(); beam_it++) {
-      Beam_Element * beam_node = *beam_it;
-      /* Create children solutions by adding one of the unassigned
-         nodes to the current solution. Calculate _greedy_weight with
-         the heuristic_information corresponding to the
-         assignment. Calculate _greedy_rank_sum.  The value of
-         child->value is the pheromone information corresponding to
+    first.resize (beam.size() + 1);
+    first[0] = 0;
+    for (size_t k = 0; k < beam.size(); k++)
+      first[k + 1] = first[k] + beam[k]->count_children (max_children);
+    children.resize (first.back());
+    partial_sum.resize (beam.size());
+
+    thread_pool->parallel_for (beam.size(), [&] (size_t k) {
+      /* Score children by adding one of the unassigned nodes to the
+         current solution. Calculate greedy_weight with the
+         heuristic_information corresponding to the
+         assignment. Calculate greedy_rank_sum.  The value of
+         child.value is the pheromone information corresponding to
          the new assignment.  */
-      Beam tmp_children = beam_node->produce_children (max_children);
-      children.splice (children.end(), tmp_children);
-    }
+      beam[k]->produce_children (k, max_children, children, first[k]);
+    });
+
+    if (prune_dominated)
+      construction->colony->beam_dominated
+        += children.remove_dominated (beam, first);
+
+    thread_pool->parallel_for (beam.size(), [&] (size_t k) {
+      double sum = 0.0;
+      for (size_t j = first[k]; j < first[k + 1]; j++)
+        sum += 1.0 / children.greedy_rank_sum[j];
+      partial_sum[k] = sum;
+    });
 
     // FIXME: For complete solutions we could skip most of what follows.
 
     double greedy_rank_basesum = 0.0;
-    for (Beam::iterator child = children.begin();
-         child != children.end(); child++) {
-      greedy_rank_basesum += 1.0 / (*child)->greedy_rank_sum;
+    for (size_t k = 0; k < beam.size(); k++) {
+      greedy_rank_basesum += partial_sum[k];
     }
     
+    thread_pool->parallel_for (beam.size(), [&] (size_t k) {
+      double sum = 0.0;
+      for (size_t j = first[k]; j < first[k + 1]; j++) {
+        // normalise all values
+        double val = children.value[j]
+          * ((1.0 / children.greedy_rank_sum[j]) / greedy_rank_basesum);
+
+        sum += val;
+        children.value[j] = val;
+      }
+      partial_sum[k] = sum;
+    });
+
     double children_basesum = 0.0;
-    for (Beam::iterator child = children.begin();
-         child != children.end(); child++) {
-      // normalise all values
-      double val = (*child)->value
-        * ((1.0 / (*child)->greedy_rank_sum) / greedy_rank_basesum);
-
-      children_basesum += val;
-      (*child)->value = val;
+    for (size_t k = 0; k < beam.size(); k++) {
+      children_basesum += partial_sum[k];
     }
 
     // Create a new beam from the current children.
-    Beam new_beam;
-    new_beam.choose_from (children, children_basesum, to_choose, det_rate, rng);
+    new_beam.clear();
+    new_beam.choose_from (beam, children, children_basesum, to_choose,
+                          det_rate, rng, pool);
 
 
     beam_depth++;
 
     if (new_beam.size() > 0) {
-      // Delete old beam.
-      for (Beam::iterator beam_node = beam.begin(); 
-           beam_node != beam.end(); beam_node++) {
-        delete(*beam_node);
-      }
-      beam.clear();
+      // Release old beam.
+      pool.release (beam);
 
       if (new_beam.size () > (size_t) beam_width) {
 
@@ -350,7 +567,7 @@ Ant::beam_construct(double det_rate,
 
         DEBUG2 (int k = 1;
                 fprintf (stderr, "new beam (done = %3d, sample_rate = %3d)   :\n",
-                         Solution::n - beam_depth, sample_rate);
+                         instance->n - beam_depth, sample_rate);
                 for (Beam::iterator beam_node = new_beam.begin();
                      beam_node != new_beam.end(); beam_node++) {
                   fprintf (stderr, " beam %3d   : ", k);
@@ -358,16 +575,32 @@ Ant::beam_construct(double det_rate,
                   k++;
                 });
 
-        if (Solution::n - beam_depth <= sample_rate) {
-        
-          for (Beam::iterator beam_node = new_beam.begin(); 
-               beam_node != new_beam.end();)     {
-          
-            if (best == NULL or (*beam_node)->better_than(best)) {
-                // This solution may improve the beam so sample it.
-                Ant *best_of_sampling = 
-                    (*beam_node)->stochastic_sampling (n_samples, det_rate);
-
+        if (instance->n - beam_depth <= sample_rate) {
+          Timer timer_sampling (task_clock());
+          // Every element that may improve the best solution found so
+          // far is sampled in parallel. Each element has its own stream
+          // of random numbers, so the result does not depend on the
+          // number of threads.
+          long seed = rng->rand_int (INT_MAX);
+          sampled.assign (new_beam.size(), NULL);
+          thread_pool->parallel_for (new_beam.size(), [&] (size_t k) {
+            if (best == NULL or new_beam[k]->better_than(best))
+              sampled[k] = new_beam[k]->stochastic_sampling
+                (n_samples, det_rate, Random::derive_seed (seed, k));
+          });
+
+          // Merge in beam order, as if the elements were sampled one
+          // after the other.
+          size_t kept = 0;
+          for (size_t k = 0; k < new_beam.size(); k++) {
+            Beam_Element *beam_node = new_beam[k];
+            Ant *best_of_sampling = sampled[k];
+
+            // Only elements that could improve best were sampled above,
+            // and best can only have improved since. An element that
+            // was not sampled is dropped like one that cannot improve.
+            if (best_of_sampling != NULL
+                and (best == NULL or beam_node->better_than(best))) {
               if (best == NULL) {
                 best = best_of_sampling;
                 DEBUG2 (fprintf (stderr, "BEST OF SAMPLING: ");
@@ -381,26 +614,30 @@ Ant::beam_construct(double det_rate,
               } else {
                 delete best_of_sampling;
               }
-              beam_node++;
+              new_beam[kept++] = beam_node;
               
             } else {
               // Do not bother to sample this solution.
-              delete (*beam_node);
-              beam_node = new_beam.erase(beam_node);
+              delete best_of_sampling;
+              pool.release (beam_node);
               count_skipped++;
             }
           }
+          construction->time_sampling += timer_sampling.elapsed_time_virtual();
+          new_beam.resize (kept);
           
           DEBUG2 (if (count_skipped > 0) 
                     fprintf (stderr, "skipped: %d\n", count_skipped));
           
           // Sort in ascending order of _lower_bound_constraints and
           // _lower_bound (calculated by stochastic_sampling above).
-          new_beam.sort (lower_bound_compare);
+          // The new beam has at most to_choose elements, so a full
+          // (stable) sort is cheap here.
+          stable_sort (new_beam.begin(), new_beam.end(), lower_bound_compare);
 
         } else { // beam_depth > sample_rate
           // Shuffle randomly
-          random_shuffle_bidit (new_beam.begin(), new_beam.end(), *rng);
+          random_shuffle (new_beam.begin(), new_beam.end(), *rng);
           DEBUG2 (int k = 1;
                   fprintf (stderr, "shuffle beam (depth = %3d)   :\n", beam_depth);
                   for (Beam::iterator beam_node = new_beam.begin();
@@ -413,20 +650,16 @@ Ant::beam_construct(double det_rate,
       }
       
       // Keep at most beam_width solutions from the new_beam.
-      int count = 0;
-      Beam::iterator beam_node = new_beam.begin();
-      while (count < beam_width and beam_node != new_beam.end()) {
-        beam.push_back(*beam_node);
-        DEBUG3 (fprintf (stderr, "Add to beam (%2d): ", count + 1);
-                (*beam_node)->print_one_line(stderr));
-        beam_node++;
-        count++;
-      }
+      size_t count = min (new_beam.size(), size_t(beam_width));
+      beam.assign (new_beam.begin(), new_beam.begin() + count);
+      DEBUG3 (for (size_t k = 0; k < count; k++) {
+                fprintf (stderr, "Add to beam (%2d): ", int(k + 1));
+                beam[k]->print_one_line(stderr);
+              });
 
-      // Delete remaining.
-      while (beam_node != new_beam.end()) {
-        delete(*beam_node);
-        beam_node++;
+      // Release remaining.
+      for (size_t k = count; k < new_beam.size(); k++) {
+        pool.release (new_beam[k]);
       }
 
       // No solution in the beam can become better than best of sampling.
@@ -437,26 +670,13 @@ Ant::beam_construct(double det_rate,
                 fprintf (stderr, "Best of sampling: ");
                 best->print_one_line(stderr));
 
-        Solution *s = best;
-        s = s->clone();
-        delete best;
-        return s;
+        return best;
       }
 
     } else { // new_beam.size() == 0
 
-#if 1   
-      // FIXME: No need to sort O(n * log(n)), just search for the
-      // best O(n).
-      beam.sort (solution_cost_compare);
-
       // Best solution found during the beam search.
-      Ant *best_of_beam = beam.front();
-      beam.pop_front();
-#else
-      // FIXME: This should be faster O(n) but it is not!
       Ant * best_of_beam = beam.best();
-#endif
       DEBUG2 (fprintf (stderr, "Best of beam    : ");
               best_of_beam->print_one_line(stderr);
               if (best != NULL) {
@@ -472,28 +692,13 @@ Ant::beam_construct(double det_rate,
                 k++;
               });
 
-      // Destroy the beam.
-      for (Beam::iterator beam_node = beam.begin(); 
-           beam_node != beam.end(); beam_node++) {
-          //if (*beam_node != best_of_beam)
-              delete (*beam_node);
-      }
-      beam.clear();
-
-      if (best == NULL) {
-        best = best_of_beam;
-      }
-      else if (best_of_beam->better_than(best)) {
-        delete best;
-        best = best_of_beam;
-      } 
-      else {
-        delete best_of_beam; 
-      }
-
-      Solution *s = best;
+      // best_of_beam belongs to the pool, so copy it before the beam
+      // is given back to the pool.
+      Solution *s = (best == NULL or best_of_beam->better_than(best))
+        ? best_of_beam : best;
       s = s->clone();
       delete best;
+      pool.release (beam);
       return s;
     }
   }
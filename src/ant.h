@@ -29,60 +29,124 @@
 
 #include "tsptw_solution.h"
 #include "Random.h"
+#include "thread_pool.h"
+#include "Timer.h"
 #include <vector>
+#include "matrix.h"
+#include "pheromone.h"
+
+enum wheel_type_t {
+    WHEEL_LINEAR = 0,
+    WHEEL_ALIAS
+};
+
+/* What the ants of a colony share: the instance, the pheromone, the
+   threads used to build them and the statistics of the constructions.
+   Several colonies may share an instance and a pool of threads.  */
+class Colony
+{
+public:
+  Colony (const Instance *instance, Thread_Pool *thread_pool);
+
+  void reset_statistics (void);
+
+  const Instance *instance;
+  Thread_Pool *thread_pool;
+  Pheromone pheromone;
+  atomic<unsigned int> evaluations;
+  // Samples abandoned because they could not improve the best sample,
+  // and construction steps saved by doing so.
+  atomic<unsigned long> sampling_aborted;
+  atomic<unsigned long> sampling_steps_saved;
+  // Children of the beam removed because they were dominated.
+  atomic<unsigned long> beam_dominated;
+};
+
+/* What one solution construction uses besides the colony: its stream
+   of random numbers, the heuristic weights drawn for it, the product
+   of pheromone and heuristic information and the time spent sampling.
+   Ants built concurrently use one each, and the partial solutions of
+   an ant all point to the same one.  */
+class Construction
+{
+public:
+  Construction (void)
+    : colony (NULL), incumbent (NULL), rng (0), time_sampling (0.0) {};
+
+  void init (Colony *colony);
+
+  Colony *colony;
+  // A solution known beforehand, e.g. found by another process. The
+  // beam search only keeps partial solutions that may improve it.
+  const Solution *incumbent;
+  Random rng;
+  hinfo_weights_t weights;
+  Matrix<double> total;
+  // Alias tables of the rows of total, used by WHEEL_ALIAS: column j
+  // of row k is chosen with probability alias_prob[k][j] and otherwise
+  // alias_node[k][j] is chosen.
+  Matrix<double> alias_prob;
+  Matrix<int> alias_node;
+  double time_sampling;
+};
+
+/* Work timed within a task of the thread pool, such as one of the ants
+   built concurrently, runs in a single thread, so it is timed with the
+   CPU time of that thread.  */
+inline Timer::CLOCK
+task_clock (void)
+{
+  return Thread_Pool::in_task() ? Timer::THREAD_TIME : Timer::default_clock;
+}
 
 class Ant : public Solution
 {
 public:
 
-  static vector<vector<double> > pheromone;
-  static Random *rng;
-  static double time_sampling;
-  
-  static void Init (string instance, Random * rnd) {
-    Ant::rng = rnd;
-    
-    // reading the problem instance
-    Solution::LoadInstance (instance);
-    
-    // initialization of the structure that holds the pheromone values
-    Ant::pheromone = vector<vector<double> > 
-      (Solution::n, vector<double> (Solution::n));
-    
-    // pheromone * heuristic info
-    Ant::total = vector<vector<double> > 
-      (Solution::n, vector<double> (Solution::n));
-
-    Ant::time_sampling = 0;
-  };
-  
-  static void resetUniformPheromoneValues();
-  static void initUniformPheromoneValues();
-  
+  static wheel_type_t wheel_type;
+  static string get_wheel_type(void);
+  // Remove dominated children of the beam before choosing among them.
+  static bool prune_dominated;
 
-  Ant() : Solution(), probs(n) {};
+  explicit Ant (Construction *c)
+    : Solution (c->colony->instance, &c->colony->evaluations),
+      construction (c), probs (instance->n) {};
   
   Ant * clone (void) { return new Ant(*this); };
   
-  void complete (double det_rate);
-  Ant * stochastic_sampling(int n_samples, double det_rate);
+  bool complete (double det_rate, Random *r, const Ant *bound = NULL);
+
+  /* Sample number i uses its own random stream derived from seed, so
+     several partial solutions can be sampled concurrently and the
+     result does not depend on the number of threads.  */
+  Ant * stochastic_sampling(int n_samples, double det_rate, long seed);
   
   Solution* construct(double det_rate);
   Solution* beam_construct(double det_rate,
                            int beam_width, int max_children, 
                            int to_choose, int n_samples, int sample_rate);
   
+protected:
+  Construction *construction;
+
+  // Times the private kernels below (see bench_ant.cpp).
+  friend class Ant_Bench;
+
 private:
   
-  static vector<vector<double> > total;
+  void build_alias_table (int k) const;
   vector<double> probs;
   double basesum;
   
   void precompute_total (void);
   void update_probs(int);
-  int maximum_prob () const;
-  int random_wheel ();
-  int construction_step (int last, double det_rate);
+  int maximum_prob (int last) const;
+  int random_wheel (Random *r);
+  int alias_wheel (int last, Random *r) const;
+  int candidate_step (int last, bool det, Random *r) const;
+  // Adds the evaluations to count rather than to *evaluations.
+  int construction_step (int last, double det_rate, Random *r,
+                         unsigned int &count);
 };
 
 #endif
@@ -7,166 +7,345 @@ void Beam_Element::commit()
   DEBUG3(fprintf(stderr, "commit: "); print_one_line(stderr));
 }
 
-Beam::iterator
-Beam::random_wheel (Random * rnd, double basesum)
+Beam_Pool::~Beam_Pool()
 {
-  double rand = rnd->next() * basesum;
-  Beam::iterator it = this->begin();
-  double wheel = (*it)->value;
+  for (size_t i = 0; i < free_list.size(); i++)
+    delete free_list[i];
+}
 
-  while (wheel < rand) {
-    it++;
-    wheel +=  (*it)->value;
-    //    cerr << (*it)->node << "  " << (*it)->value << endl;
-  }
-  assert ((*it)->node >= 0);
-  assert (it != this->end());
+Beam_Element *
+Beam_Pool::acquire (const Beam_Element &parent)
+{
+  if (free_list.empty())
+    return new Beam_Element (parent);
 
-  return it;
+  Beam_Element *e = free_list.back();
+  free_list.pop_back();
+  *e = parent;
+  return e;
 }
 
-bool child_greedy_weight_compare(const Beam_Element * c1, 
-                                 const Beam_Element * c2)
+void
+Beam_Pool::release (Beam &beam)
 {
-  return c1->greedy_weight > c2->greedy_weight;
+  free_list.insert (free_list.end(), beam.begin(), beam.end());
+  beam.clear();
 }
 
-bool solution_cost_compare (const Beam_Element* c1, const Beam_Element* c2)
+void
+Beam_Children::resize (size_t n)
 {
-  return c1->better_than (c2);
+  parent.resize (n);
+  node.resize (n);
+  value.resize (n);
+  greedy_weight.resize (n);
+  greedy_rank_sum.resize (n);
 }
 
-Beam
-Beam_Element::produce_children (int max_children) 
+void
+Beam_Children::set (size_t k, int parent_, int node_, double value_,
+                    double greedy_weight_, double greedy_rank_sum_)
+{
+  parent[k] = parent_;
+  node[k] = node_;
+  value[k] = value_;
+  greedy_weight[k] = greedy_weight_;
+  greedy_rank_sum[k] = greedy_rank_sum_;
+}
+
+namespace {
+struct child_state
 {
-  Beam child_list;
+  uint64_t hash;
+  int node;
+  int cviols;
+  number_t mkspan;
+  number_t tourcost;
+  size_t k;
+
+  bool operator< (const child_state &other) const {
+    if (hash != other.hash) return hash < other.hash;
+    if (node != other.node) return node < other.node;
+    return k < other.k;
+  }
+  bool same_state (const child_state &other) const {
+    return hash == other.hash and node == other.node;
+  }
+  bool dominates (const child_state &other) const {
+    if (cviols > other.cviols or mkspan > other.mkspan
+        or tourcost > other.tourcost)
+      return false;
+    return (cviols < other.cviols or mkspan < other.mkspan
+            or tourcost < other.tourcost or k < other.k);
+  }
+};
+}
+
+/* Remove the children that reach the same state as another child, that
+   is, the same set of assigned customers and the same last customer,
+   with no fewer constraint violations and no smaller makespan or tour
+   cost. Completing both in the same way, the other child is never
+   worse. Of identical children, the first one is kept. States are
+   compared by their hash, so a collision could remove a child wrongly,
+   which is very unlikely with 64 bits.
+
+   parents is the beam that produced the children, and the children of
+   parents[k] are in [first[k], first[k+1]), which is updated. The
+   order of the remaining children does not change. Return the number
+   of children removed.  */
+size_t
+Beam_Children::remove_dominated (const Beam &parents, vector<size_t> &first)
+{
+  static thread_local vector<child_state> states;
+  static thread_local vector<unsigned char> removed;
+
+  // All children of one parent have different last nodes.
+  if (parents.size() < 2)
+    return 0;
+
+  states.clear();
+  for (size_t p = 0; p < parents.size(); p++) {
+    const Beam_Element *e = parents[p];
+    // Adding a node to these completes the tour.
+    if (e->nodes_available <= 2) continue;
+    for (size_t k = first[p]; k < first[p + 1]; k++) {
+      child_state c;
+      c.hash = e->visited_hash_after_add (node[k]);
+      c.node = node[k];
+      c.k = k;
+      e->evaluate_add (node[k], c.cviols, c.mkspan, c.tourcost);
+      states.push_back (c);
+    }
+  }
+  sort (states.begin(), states.end());
+
+  size_t count = 0;
+  removed.assign (size(), false);
+  for (size_t begin = 0, end; begin < states.size(); begin = end) {
+    end = begin + 1;
+    while (end < states.size() and states[begin].same_state (states[end]))
+      end++;
+    for (size_t j = begin; j < end; j++) {
+      for (size_t i = begin; i < end; i++) {
+        if (i != j and states[i].dominates (states[j])) {
+          removed[states[j].k] = true;
+          count++;
+          break;
+        }
+      }
+    }
+  }
+  if (count == 0)
+    return 0;
+
+  size_t out = 0;
+  for (size_t p = 0, begin = 0; p < parents.size(); p++) {
+    size_t end = first[p + 1];
+    for (size_t k = begin; k < end; k++) {
+      if (removed[k]) continue;
+      set (out++, parent[k], node[k], value[k], greedy_weight[k],
+           greedy_rank_sum[k]);
+    }
+    begin = end;
+    first[p + 1] = out;
+  }
+  resize (out);
+  return count;
+}
 
-  // Create new partial solutions by adding unassigned nodes to the
-  // current solution.
-  for (int k = 0, inode = 0; k < nodes_available; k++) {
-    while (node_assigned[++inode]);
+/* Index of the first child with the largest value.  */
+size_t
+Beam_Children::maximum_value (void) const
+{
+  size_t max_k = 0;
+  double max_value = value[0];
+  for (size_t k = 1; k < value.size(); k++) {
+    if (max_value < value[k]) {
+      max_value = value[k];
+      max_k = k;
+    }
+  }
+  assert (max_value > 0.0);
+  return max_k;
+}
 
-    // Creates a child by copying solution.
-    Beam_Element * child = this->clone();
-    child->node = inode;
-    int last = child->permutation.back();
-    child->greedy_weight = child->heuristic_information (last, child->node);
+size_t
+Beam_Children::random_wheel (Random * rnd, double basesum) const
+{
+  double rand = rnd->next() * basesum;
+  size_t k = 0;
+  double wheel = value[k];
+  size_t last_k = k;
 
-    child_list.push_back (child);
-    DEBUG3 (fprintf (stderr, "Child: %2d, %g\t", 
-                     child->node, child->greedy_weight);
-            child->print_one_line(stderr));
+  while (wheel < rand || value[k] <= 0.0) {
+    if (value[k] > 0.0)
+      last_k = k;
+    k++;
+    // basesum is updated incrementally, so rounding may push rand
+    // beyond the real sum of values.
+    if (k == value.size()) {
+      k = last_k;
+      break;
+    }
+    wheel += value[k];
   }
+  assert (value[k] > 0.0);
+  assert (node[k] >= 0);
 
-  child_list.sort (child_greedy_weight_compare);
+  return k;
+}
 
-  int count = 1;
-  Beam::iterator chi = child_list.begin();
-  while (count <= max_children and chi != child_list.end()) {
-    Beam_Element *child = *chi;
-    
-    child->greedy_rank_sum = child->greedy_rank_sum + count;
+bool solution_cost_compare (const Beam_Element* c1, const Beam_Element* c2)
+{
+  return c1->better_than (c2);
+}
 
-    int last = child->permutation.back();
-    child->value = child->pheromone[last][child->node];
+/* Larger greedy weight first. Ties are broken by node, so the order
+   does not depend on how candidates are generated.  */
+static bool
+candidate_greedy_weight_compare (const pair<double,int> & c1,
+                                 const pair<double,int> & c2)
+{
+  return c1.first > c2.first
+    || (c1.first == c2.first && c1.second < c2.second);
+}
 
-    chi++;
-    count++;
+/* Number of children produced by produce_children. With candidate
+   lists, only the candidates of the last node that can still be
+   reached within their time window are expanded, unless there are
+   none.  */
+int
+Beam_Element::count_children (int max_children) const
+{
+  static thread_local vector<int> cand;
+  int count = nodes_available;
+  if (instance->candidate_list_size > 0) {
+    int n_cand = feasible_candidates (permutation.back(), cand);
+    if (n_cand > 0)
+      count = n_cand;
   }
+  return min (count, max_children);
+}
+
+/* Store in children, from position first onwards, the
+   count_children(max_children) best children of this partial solution
+   according to the heuristic information. parent is the index of this
+   solution in its beam. Several beam elements may produce their
+   children concurrently, as long as their positions do not overlap.  */
+void
+Beam_Element::produce_children (int parent, int max_children,
+                                Beam_Children &children, size_t first) const
+{
+  static thread_local vector<pair<double,int> > candidates;
+  static thread_local vector<int> cand;
+  const hinfo_weights_t &w = construction->weights;
+  int last = permutation.back();
 
-  // Cleanup unused children
-  Beam::iterator chi2 = chi;
-  while (chi2 != child_list.end()) {
-    Beam_Element *child = *chi2;
-    delete child;
-    chi2++;
+  // Score new partial solutions obtained by adding unassigned nodes
+  // to the current solution.
+  candidates.clear();
+  if (instance->candidate_list_size > 0) {
+    int n_cand = feasible_candidates (last, cand);
+    for (int k = 0; k < n_cand; k++) {
+      double h = instance->heuristic_information (w, last, cand[k]);
+      candidates.push_back (make_pair (h, cand[k]));
+    }
+  }
+  if (candidates.empty()) {
+    for (int k = 0, inode = 0; k < nodes_available; k++) {
+      while (node_assigned[++inode]);
+      double h = instance->heuristic_information (w, last, inode);
+      candidates.push_back (make_pair (h, inode));
+    }
+  }
+  DEBUG3 (for (size_t k = 0; k < candidates.size(); k++) {
+            fprintf (stderr, "Child: %2d, %g\n",
+                     candidates[k].second, candidates[k].first);
+          });
+
+  // Only the best max_children need to be ranked. The comparison is a
+  // total order, so the result does not depend on the algorithm.
+  size_t count = min (candidates.size(), size_t(max_children));
+  assert (int(count) == count_children (max_children));
+  if (count < candidates.size())
+    nth_element (candidates.begin(), candidates.begin() + count,
+                 candidates.end(), candidate_greedy_weight_compare);
+  sort (candidates.begin(), candidates.begin() + count,
+        candidate_greedy_weight_compare);
+
+  const double *tau = construction->colony->pheromone[last];
+  for (size_t k = 0; k < count; k++) {
+    int node = candidates[k].second;
+    children.set (first + k, parent, node, tau[node],
+                  candidates[k].first,
+                  greedy_rank_sum + double(k + 1));
   }
-  child_list.erase (chi, child_list.end());
-  
-  return child_list;
 }
 
-bool child_value_compare(const Beam_Element * c1, const Beam_Element * c2)
+/* Build the Beam_Element corresponding to the k-th child and add it to
+   the beam.  */
+static void
+commit_child (Beam &beam, const Beam &parents, const Beam_Children &children,
+              size_t k, Beam_Pool &pool)
 {
-  /*  return (c1->value > c2->value) ? true 
-    : (c1->value < c2->value) ? false
-    : (Ant::rng->next() < 0.5) ? true : false;*/
-  return c1->value > c2->value;
+  Beam_Element *e = pool.acquire (*parents[children.parent[k]]);
+  e->node = children.node[k];
+  e->value = children.value[k];
+  e->greedy_weight = children.greedy_weight[k];
+  e->greedy_rank_sum = children.greedy_rank_sum[k];
+  e->commit();
+  beam.push_back (e);
 }
 
-/* Create a new beam from children with at most to_choose elements.  */
+#define DEBUG_PRINT_CHILD(K)                                              \
+  fprintf(stderr, "node = %2d  val = %.7f  g_w = %.7f  g_r_s = %4g  ",   \
+          children.node[K], children.value[K],                            \
+          children.greedy_weight[K], children.greedy_rank_sum[K]);        \
+  parents[children.parent[K]]->print_one_line (stderr)
+
+/* Create a new beam from children with at most to_choose
+   elements. parents is the beam that produced children.  */
 void
-Beam::choose_from (Beam &children, double children_basesum, 
-                   int to_choose, double det_rate, Random *rng)
+Beam::choose_from (const Beam &parents, Beam_Children &children,
+                   double children_basesum, int to_choose,
+                   double det_rate, Random *rng, Beam_Pool &pool)
 {
-  if (int(children.size()) <= to_choose) {
+  DEBUG3 (fprintf (stderr, "Children.size (%d) %s to_choose (%d)"
+                   " (basesum = %g)\n", int(children.size()),
+                   int(children.size()) <= to_choose ? "<=" : ">",
+                   to_choose, children_basesum);
+          for (size_t k = 0; k < children.size(); k++) {
+            fprintf(stderr, "Child %2d: ", int(k));
+            DEBUG_PRINT_CHILD (k);
+          });
 
-    DEBUG3 (fprintf (stderr, 
-                     "Children.size (%d) <= to_choose (%d) (basesum = %g)\n", 
-                     children.size(), to_choose, children_basesum);
-            int k = 0;
-            for (Beam::iterator child = children.begin(); 
-                 child != children.end(); child++) {
-              fprintf(stderr, "Child %2d: node = %2d  val = %.7f  "
-                      "g_w = %.7f  g_r_s = %4g  ",
-                      k++, (*child)->node, (*child)->value, 
-                      (*child)->greedy_weight, 
-                      (*child)->greedy_rank_sum);
-              (*child)->print_one_line (stderr);
-            });
-
-    for (Beam::iterator child = children.begin(); 
-         child != children.end(); child++) {
-      (*child)->commit();
-      this->push_back (*child);
+  if (int(children.size()) <= to_choose) {
+    for (size_t k = 0; k < children.size(); k++) {
+      commit_child (*this, parents, children, k, pool);
     }
   }
   else {
-    children.sort (child_value_compare);
-    
-    DEBUG3 (fprintf (stderr, 
-                     "Children.size (%d) > to_choose (%d) (basesum = %g)\n", 
-                     children.size(), to_choose, children_basesum);
-            int k = 0;
-            for (Beam::iterator child = children.begin(); 
-                 child != children.end(); child++) {
-              fprintf(stderr, "Child %2d: node = %2d  val = %.7f  "
-                      "g_w = %.7f  g_r_s = %4g  ",
-                      k++, (*child)->node, (*child)->value, 
-                      (*child)->greedy_weight, 
-                      (*child)->greedy_rank_sum);
-              (*child)->print_one_line (stderr);
-            });
-    
+    /* Children are not sorted: the deterministic choice is a linear
+       search for the maximum value, and the probability of each child
+       in the roulette wheel does not depend on the order.  */
     for (int i = 0; i < to_choose; i++) {
-      list <Beam_Element *>::iterator child;
+      size_t k;
       
       if (det_rate >= 1.0 or (det_rate > 0.0  and rng->next() < det_rate)) {
-        
-        child = children.begin();
-        DEBUG3 (fprintf(stderr, "choose determ: "
-                        "node = %2d  val = %.7f g_w = %.7f  g_r_s = %4g  ",
-                        (*child)->node, (*child)->value, 
-                        (*child)->greedy_weight, (*child)->greedy_rank_sum));
+        k = children.maximum_value();
+        DEBUG3 (fprintf(stderr, "choose determ: ");
+                DEBUG_PRINT_CHILD (k));
       } else {
-        
-        child = children.random_wheel (rng, children_basesum);
-        DEBUG3 (fprintf(stderr,"choose random: " 
-                        "node = %2d  val = %.7f g_w = %.7f  g_r_s = %4g  ",
-                        (*child)->node, (*child)->value, 
-                        (*child)->greedy_weight, (*child)->greedy_rank_sum));
+        k = children.random_wheel (rng, children_basesum);
+        DEBUG3 (fprintf(stderr,"choose random: ");
+                DEBUG_PRINT_CHILD (k));
       }
-      (*child)->commit();
-      this->push_back (*child);
-      children_basesum = children_basesum - (*child)->value;
-      children.erase (child);
-    }
-    // Delete all unused children (those never stored in the new_beam). 
-    for (Beam::iterator child = children.begin(); 
-         child != children.end(); child++) {
-      delete (*child);
+      commit_child (*this, parents, children, k, pool);
+      children_basesum = children_basesum - children.value[k];
+      children.value[k] = 0.0;
     }
   }
   children.clear();
 }
 
+#undef DEBUG_PRINT_CHILD
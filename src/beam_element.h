@@ -1,12 +1,13 @@
 #pragma once
 #include "ant.h"
 
-#include <list>
 #include <vector>
 #include <algorithm>
 #include <functional>
 
 class Beam; // forward declaration to avoid circular dependency.
+class Beam_Children;
+class Beam_Pool;
 
 // FIXME: The correct dependency would be a class Beam-ACO that makes
 // use of both Beam_element and Ant, so Ant should not depend on
@@ -18,50 +19,82 @@ public:
   double greedy_weight;
   double greedy_rank_sum;
 
-  Beam_Element() 
-    : Ant(), node (-1), value (0.0), greedy_weight (0.0), greedy_rank_sum (0.0)
+  explicit Beam_Element (Construction *c)
+    : Ant (c), node (-1), value (0.0), greedy_weight (0.0), greedy_rank_sum (0.0)
   { };
 
   Beam_Element * clone (void) { return new Beam_Element(*this); };
 
-  Beam produce_children (int max_children);
+  void produce_children (int parent, int max_children,
+                         Beam_Children &children, size_t first) const;
+  int count_children (int max_children) const;
 
   void commit(void);
 };
 
 bool solution_cost_compare (const Beam_Element* c1, const Beam_Element* c2);
 
-class Beam : public list<Beam_Element*> 
+/* The candidate children of a beam, that is, the index of their
+   parent in the beam plus the node that would be added to it. They
+   are stored as parallel arrays, so the loops that normalise and
+   select children only touch the data they need.  Children are only
+   scored; a Beam_Element is built for them only once they are chosen
+   for the new beam (see Beam::choose_from).  */
+class Beam_Children
 {
 public:
-  Beam::iterator random_wheel (Random *r, double basesum);
-  void choose_from (Beam &children, double children_basesum, int to_choose, double det_rate,
-                    Random *rng);
+  vector<int> parent;
+  vector<int> node;
+  vector<double> value;
+  vector<double> greedy_weight;
+  vector<double> greedy_rank_sum;
+
+  size_t size (void) const { return node.size(); }
+  void resize (size_t n);
+  void set (size_t k, int parent, int node, double value,
+            double greedy_weight, double greedy_rank_sum);
+  void clear (void) { resize (0); }
+  size_t remove_dominated (const Beam &parents, vector<size_t> &first);
+
+  // A chosen child keeps its slot but its value is set to zero.
+  size_t maximum_value (void) const;
+  size_t random_wheel (Random *r, double basesum) const;
+};
+
+class Beam : public vector<Beam_Element*> 
+{
+public:
+  void choose_from (const Beam &parents, Beam_Children &children,
+                    double children_basesum, int to_choose,
+                    double det_rate, Random *rng, Beam_Pool &pool);
   Beam_Element *
   best(void) {
-      auto it = this->begin();
-      Beam_Element * best = *it;
-      for (it++; it != this->end(); it++) {
-          if (solution_cost_compare(best, *it))
-              best = *it;
-      }
-      return best; 
+      return *min_element (this->begin(), this->end(),
+                           solution_cost_compare);
   }
 };
 
-template<typename _BidirectionalIterator, typename _RandomNumberGenerator>
-    void
-    random_shuffle_bidit ( _BidirectionalIterator begin,
-                           _BidirectionalIterator end,
-                           _RandomNumberGenerator& __rand)
+/* Beam elements are created and destroyed by the hundreds at every
+   depth of the beam construction. Instead of new/delete, they are
+   recycled through this pool: a released element keeps the capacity
+   of its vectors, so copying a parent into it does not allocate.  All
+   elements are freed when the pool is destroyed at the end of the
+   construction.  */
+class Beam_Pool
 {
-    typedef typename
-        std::iterator_traits<_BidirectionalIterator>::value_type
-        value_type;
-    std::vector<value_type> v( begin, end );
-    std::random_shuffle( v.begin(), v.end(), __rand);
-    std::copy( v.begin(), v.end(), begin );
-}
+public:
+  ~Beam_Pool();
+  // Returns a copy of parent.
+  Beam_Element * acquire (const Beam_Element &parent);
+  // The pool takes ownership of e, which must have been allocated
+  // with new (or acquired from the pool).
+  void release (Beam_Element *e) { free_list.push_back (e); }
+  // Release all elements of the beam and leave it empty.
+  void release (Beam &beam);
+
+private:
+  vector<Beam_Element*> free_list;
+};
 
 // Local Variables:
 // mode: c++
@@ -0,0 +1,95 @@
+/*************************************************************************
+
+ Beam-ACO
+
+ ---------------------------------------------------------------------
+
+                       Copyright (c) 2008
+                  Christian Blum <christian.blum@ehu.es>
+             Manuel Lopez-Ibanez <manuel.lopez-ibanez@manchester.ac.uk>
+
+ This program is free software (software libre); you can redistribute
+ it and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2 of the
+ License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, you can obtain a copy of the GNU
+ General Public License at: http://www.gnu.org/licenses/gpl.html
+
+ ---------------------------------------------------------------------
+
+  Microbenchmark of Solution::two_opt_is_infeasible.
+
+  Usage: bench_2opt INSTANCE [SWEEPS]
+
+  Build it with 'make bench DEBUG=0'.
+
+*************************************************************************/
+
+#include "tsptw_solution.h"
+#include "Timer.h"
+#include <algorithm>
+#include <cstdlib>
+
+int main (int argc, char **argv)
+{
+  if (argc < 2) {
+    printf ("usage: %s INSTANCE [SWEEPS]\n", argv[0]);
+    exit (1);
+  }
+  int sweeps = (argc > 2) ? atoi (argv[2]) : 1000;
+  if (sweeps < 1) {
+    printf ("error: SWEEPS must be at least 1\n");
+    exit (1);
+  }
+
+  Instance instance (argv[1]);
+  const int n = instance.n;
+  atomic<unsigned int> evaluations (0);
+
+  // Visit the customers by the end of their time windows, so that the
+  // tour is close to feasible and checks do not all stop at once.
+  vector<int> order;
+  for (int i = 1; i < n; i++)
+    order.push_back (i);
+  stable_sort (order.begin(), order.end(), [&] (int a, int b) {
+      return instance.window_end[a] < instance.window_end[b];
+    });
+  Solution s (&instance, &evaluations);
+  s.add (&order[0]);
+
+  /* Check every move of each sweep, whether it improves the tour or
+     not, stopping like two_opt_first() when no longer segment can be
+     feasible. A feasible move is done, because the check has then
+     already updated the start times of the tour.  */
+  unsigned long calls = 0, moves = 0;
+  long checksum = 0;
+  Timer timer;
+  for (int k = 0; k < sweeps; k++) {
+    for (int h1 = 0; h1 < n - 2; h1++) {
+      for (int h3 = h1 + 2; h3 < n; h3++) {
+        int infeas = s.two_opt_is_infeasible (h1, h3);
+        calls++;
+        checksum += infeas;
+        if (infeas == 2)
+          break;
+        if (infeas == 0) {
+          s.two_opt_move (h1, h3);
+          moves++;
+        }
+      }
+    }
+  }
+  double t = timer.elapsed_time_virtual ();
+
+  printf ("# n = %d, sweeps = %d, calls = %lu, moves = %lu, checksum = %ld\n",
+          n, sweeps, calls, moves, checksum);
+  printf ("two_opt_is_infeasible %12.3f ns/call\n", 1e9 * t / calls);
+  return 0;
+}
@@ -0,0 +1,113 @@
+/*************************************************************************
+
+ Beam-ACO
+
+ ---------------------------------------------------------------------
+
+                       Copyright (c) 2008
+                  Christian Blum <christian.blum@ehu.es>
+             Manuel Lopez-Ibanez <manuel.lopez-ibanez@manchester.ac.uk>
+
+ This program is free software (software libre); you can redistribute
+ it and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2 of the
+ License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, you can obtain a copy of the GNU
+ General Public License at: http://www.gnu.org/licenses/gpl.html
+
+ ---------------------------------------------------------------------
+
+  Microbenchmark of the kernels used to build an ant: precompute_total,
+  update_probs and maximum_prob.
+
+  Usage: bench_ant INSTANCE [REPETITIONS]
+
+  Build it with 'make bench DEBUG=0'.
+
+*************************************************************************/
+
+#include "ant.h"
+#include "Timer.h"
+#include <cstdlib>
+
+class Ant_Bench
+{
+public:
+  static void run (const Instance &instance, int reps);
+};
+
+/* Time each kernel on an ant with half of its nodes assigned, which is
+   the average state during a construction. The checksum keeps the
+   compiler from dropping the calls.  */
+void
+Ant_Bench::run (const Instance &instance, int reps)
+{
+  const int n = instance.n;
+  Thread_Pool thread_pool (1);
+  Colony colony (&instance, &thread_pool);
+  Construction construction;
+  construction.init (&colony);
+  construction.rng = Random (1);
+  construction.weights = Solution::random_hinfo_weights (&construction.rng);
+
+  Ant ant (&construction);
+  ant.precompute_total ();
+  int last = 0;
+  while (ant.nodes_available > n / 2) {
+    int node = 1 + construction.rng.rand_int (n - 1);
+    if (ant.node_assigned[node]) continue;
+    ant.add (last, node);
+    last = node;
+  }
+
+  double checksum = 0.0;
+  Timer timer;
+
+  timer.reset ();
+  for (int i = 0; i < reps; i++) {
+    ant.precompute_total ();
+    checksum += construction.total[i % n][0];
+  }
+  double t_total = timer.elapsed_time_virtual ();
+
+  timer.reset ();
+  for (int i = 0; i < reps; i++) {
+    ant.update_probs (last);
+    checksum += ant.basesum;
+  }
+  double t_probs = timer.elapsed_time_virtual ();
+
+  timer.reset ();
+  for (int i = 0; i < reps; i++)
+    checksum += ant.maximum_prob (last);
+  double t_max = timer.elapsed_time_virtual ();
+
+  printf ("# n = %d, repetitions = %d, checksum = %g\n", n, reps, checksum);
+  printf ("precompute_total %12.3f us/call\n", 1e6 * t_total / reps);
+  printf ("update_probs     %12.3f us/call\n", 1e6 * t_probs / reps);
+  printf ("maximum_prob     %12.3f us/call\n", 1e6 * t_max / reps);
+}
+
+int main (int argc, char **argv)
+{
+  if (argc < 2) {
+    printf ("usage: %s INSTANCE [REPETITIONS]\n", argv[0]);
+    exit (1);
+  }
+  int reps = (argc > 2) ? atoi (argv[2]) : 100000;
+  if (reps < 1) {
+    printf ("error: REPETITIONS must be at least 1\n");
+    exit (1);
+  }
+
+  Instance instance (argv[1]);
+  Ant_Bench::run (instance, reps);
+  return 0;
+}
@@ -0,0 +1,126 @@
+/*************************************************************************
+
+ Beam-ACO
+
+ ---------------------------------------------------------------------
+
+                       Copyright (c) 2008
+                  Christian Blum <christian.blum@ehu.es>
+             Manuel Lopez-Ibanez <manuel.lopez-ibanez@manchester.ac.uk>
+
+ This program is free software (software libre); you can redistribute
+ it and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2 of the
+ License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, you can obtain a copy of the GNU
+ General Public License at: http://www.gnu.org/licenses/gpl.html
+
+*************************************************************************/
+
+
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <algorithm>
+
+/* A rows x cols matrix stored row-major in a single block. Each row
+   starts on a cache line (the stride is padded), so that loops over a
+   row can use aligned vector loads. m[i][j] works as with
+   vector<vector<T> >, but m[i] is a plain pointer to row i.
+
+   T must be a trivially copyable type such as a number or a flag.  */
+template<typename T>
+class Matrix
+{
+public:
+  Matrix (void) : _rows(0), _cols(0), _stride(0), _data(NULL) {}
+
+  Matrix (size_t rows, size_t cols, const T &value = T())
+    : _rows(0), _cols(0), _stride(0), _data(NULL)
+  {
+    resize (rows, cols);
+    fill (value);
+  }
+
+  Matrix (const Matrix &other)
+    : _rows(0), _cols(0), _stride(0), _data(NULL)
+  {
+    *this = other;
+  }
+
+  Matrix & operator= (const Matrix &other)
+  {
+    if (this != &other) {
+      resize (other._rows, other._cols);
+      if (_data)
+        memcpy (_data, other._data, size_bytes());
+    }
+    return *this;
+  }
+
+  ~Matrix () { free (_data); }
+
+  T * operator[] (size_t i) { return _data + i * _stride; }
+  const T * operator[] (size_t i) const { return _data + i * _stride; }
+
+  size_t rows (void) const { return _rows; }
+  size_t cols (void) const { return _cols; }
+  size_t stride (void) const { return _stride; }
+
+  void fill (const T &value)
+  {
+    std::fill (_data, _data + _rows * _stride, value);
+  }
+
+  void swap (Matrix &other)
+  {
+    std::swap (_rows, other._rows);
+    std::swap (_cols, other._cols);
+    std::swap (_stride, other._stride);
+    std::swap (_data, other._data);
+  }
+
+private:
+  static const size_t alignment = 64;
+
+  size_t _rows, _cols, _stride;
+  T *_data;
+
+  size_t size_bytes (void) const { return _rows * _stride * sizeof(T); }
+
+  /* Contents are undefined after resizing.  */
+  void resize (size_t rows, size_t cols)
+  {
+    const size_t per_line = std::max (alignment / sizeof(T), size_t(1));
+    size_t stride = (cols + per_line - 1) / per_line * per_line;
+
+    if (rows * stride != _rows * _stride) {
+      free (_data);
+      _data = NULL;
+      if (rows * stride > 0) {
+        void *p;
+        if (posix_memalign (&p, alignment, rows * stride * sizeof(T)) != 0)
+          throw std::bad_alloc();
+        _data = static_cast<T *>(p);
+      }
+    }
+    _rows = rows;
+    _cols = cols;
+    _stride = stride;
+  }
+};
+
+#endif
+// Local Variables: 
+// mode: c++; 
+// End:
@@ -0,0 +1,80 @@
+/*************************************************************************
+
+ Beam-ACO
+
+ ---------------------------------------------------------------------
+
+                       Copyright (c) 2008
+                  Christian Blum <christian.blum@ehu.es>
+             Manuel Lopez-Ibanez <manuel.lopez-ibanez@manchester.ac.uk>
+
+ This program is free software (software libre); you can redistribute
+ it and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2 of the
+ License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, you can obtain a copy of the GNU
+ General Public License at: http://www.gnu.org/licenses/gpl.html
+
+*************************************************************************/
+
+#include "migration.h"
+#include <cassert>
+#include <cstddef>
+
+Migration::Migration (int n_islands_, int n, migration_topology_t topology_)
+  : n_islands (n_islands_), topology (topology_), slots (n_islands_)
+{
+  for (int i = 0; i < n_islands; i++)
+    slots[i].tour = std::vector<std::atomic<int> > (n + 1);
+  clear();
+}
+
+void
+Migration::clear (void)
+{
+  for (int i = 0; i < n_islands; i++)
+    slots[i].version.store (0);
+}
+
+void
+Migration::publish (int island, const std::vector<int> &tour)
+{
+  Slot &slot = slots[island];
+  assert (tour.size() == slot.tour.size());
+
+  unsigned long version = slot.version.load (std::memory_order_relaxed);
+  slot.version.store (version + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence (std::memory_order_release);
+  for (std::size_t k = 0; k < tour.size(); k++)
+    slot.tour[k].store (tour[k], std::memory_order_relaxed);
+  slot.version.store (version + 2, std::memory_order_release);
+}
+
+bool
+Migration::receive (int from, std::vector<int> &tour,
+                    unsigned long &seen) const
+{
+  const Slot &slot = slots[from];
+
+  unsigned long version = slot.version.load (std::memory_order_acquire);
+  if (version == seen or version % 2 == 1)
+    return false;
+
+  tour.resize (slot.tour.size());
+  for (std::size_t k = 0; k < tour.size(); k++)
+    tour[k] = slot.tour[k].load (std::memory_order_relaxed);
+
+  std::atomic_thread_fence (std::memory_order_acquire);
+  if (slot.version.load (std::memory_order_relaxed) != version)
+    return false;
+
+  seen = version;
+  return true;
+}
@@ -0,0 +1,88 @@
+/*************************************************************************
+
+ Beam-ACO
+
+ ---------------------------------------------------------------------
+
+                       Copyright (c) 2008
+                  Christian Blum <christian.blum@ehu.es>
+             Manuel Lopez-Ibanez <manuel.lopez-ibanez@manchester.ac.uk>
+
+ This program is free software (software libre); you can redistribute
+ it and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2 of the
+ License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, you can obtain a copy of the GNU
+ General Public License at: http://www.gnu.org/licenses/gpl.html
+
+*************************************************************************/
+
+#ifndef MIGRATION_H
+#define MIGRATION_H
+
+#include <vector>
+#include <atomic>
+
+enum migration_topology_t {
+    MIGRATION_RING = 0,
+    MIGRATION_ALL
+};
+
+/* Where the islands of a trial publish their best tours for the other
+   islands to read.
+
+   Each island owns one slot and is the only one that writes it. Slots
+   are read and written without locks: a slot holds the tour in atomic
+   integers and a version that is odd while the tour is being
+   rewritten. A reader that sees the version change while it copies the
+   tour just gives up, and tries again at the next exchange.  */
+class Migration
+{
+public:
+  Migration (int n_islands, int n, migration_topology_t topology);
+
+  int size (void) const { return n_islands; }
+
+  // Forget all tours. Only valid while no island is running.
+  void clear (void);
+
+  // Does island 'to' take the tours published by island 'from'?
+  bool receives (int to, int from) const {
+    return to != from
+      and (topology == MIGRATION_ALL
+           or from == (to + n_islands - 1) % n_islands);
+  }
+
+  // Publish tour, from depot to depot, as the tour of island.
+  void publish (int island, const std::vector<int> &tour);
+
+  /* Copy the tour of island 'from' into tour if it was published
+     after version seen, which is then updated.  */
+  bool receive (int from, std::vector<int> &tour,
+                unsigned long &seen) const;
+
+private:
+  struct Slot {
+    std::atomic<unsigned long> version;
+    std::vector<std::atomic<int> > tour;
+  };
+
+  int n_islands;
+  migration_topology_t topology;
+  std::vector<Slot> slots;
+
+  Migration (const Migration &);
+  Migration & operator= (const Migration &);
+};
+
+#endif
+// Local Variables: 
+// mode: c++; 
+// End:
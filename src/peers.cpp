@@ -0,0 +1,393 @@
+/*************************************************************************
+
+ Beam-ACO
+
+ ---------------------------------------------------------------------
+
+                       Copyright (c) 2008
+                  Christian Blum <christian.blum@ehu.es>
+             Manuel Lopez-Ibanez <manuel.lopez-ibanez@manchester.ac.uk>
+
+ This program is free software (software libre); you can redistribute
+ it and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2 of the
+ License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, you can obtain a copy of the GNU
+ General Public License at: http://www.gnu.org/licenses/gpl.html
+
+*************************************************************************/
+
+#include "peers.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace std;
+
+// Longest line accepted from a peer, in characters per node.
+static const size_t max_line_per_node = 24;
+
+// Seconds to wait before connecting again to a peer that failed.
+static const int retry_seconds = 10;
+
+/* Fill addr with address, either unix:PATH or HOST:PORT, where an
+   empty HOST means any local address. Return false if it is not
+   valid.  */
+static bool
+resolve (const string &address, bool passive,
+         sockaddr_storage &addr, socklen_t &length)
+{
+  memset (&addr, 0, sizeof (addr));
+
+  if (address.compare (0, 5, "unix:") == 0) {
+    sockaddr_un &un = (sockaddr_un &) addr;
+    string path = address.substr (5);
+    if (path.empty() or path.size() >= sizeof (un.sun_path))
+      return false;
+    un.sun_family = AF_UNIX;
+    strcpy (un.sun_path, path.c_str());
+    length = sizeof (un);
+    return true;
+  }
+
+  size_t colon = address.rfind (':');
+  if (colon == string::npos)
+    return false;
+  string host = address.substr (0, colon);
+  string port = address.substr (colon + 1);
+
+  addrinfo hints, *result;
+  memset (&hints, 0, sizeof (hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = passive ? AI_PASSIVE : 0;
+  if (getaddrinfo (host.empty() ? NULL : host.c_str(), port.c_str(),
+                   &hints, &result) != 0)
+    return false;
+  memcpy (&addr, result->ai_addr, result->ai_addrlen);
+  length = result->ai_addrlen;
+  freeaddrinfo (result);
+  return true;
+}
+
+/* Connect to address, giving up after one second so that a peer
+   that is not reachable does not hold up the other peers. Return the
+   socket, or -1.  */
+static int
+connect_to (const string &address)
+{
+  sockaddr_storage addr;
+  socklen_t length;
+  if (!resolve (address, false, addr, length))
+    return -1;
+
+  int fd = socket (addr.ss_family, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+
+  int flags = fcntl (fd, F_GETFL);
+  fcntl (fd, F_SETFL, flags | O_NONBLOCK);
+  int error = 0;
+  if (connect (fd, (sockaddr *) &addr, length) < 0) {
+    error = errno;
+    if (error == EINPROGRESS) {
+      pollfd p = { fd, POLLOUT, 0 };
+      socklen_t size = sizeof (error);
+      if (poll (&p, 1, 1000) == 1)
+        getsockopt (fd, SOL_SOCKET, SO_ERROR, &error, &size);
+      else
+        error = ETIMEDOUT;
+    }
+  }
+  if (error != 0) {
+    close (fd);
+    return -1;
+  }
+  fcntl (fd, F_SETFL, flags);
+
+  // A peer that does not read its tours is dropped after one second.
+  timeval timeout = { 1, 0 };
+  setsockopt (fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof (timeout));
+  return fd;
+}
+
+static pollfd
+poll_in (int fd)
+{
+  pollfd p = { fd, POLLIN, 0 };
+  return p;
+}
+
+static bool
+write_all (int fd, const string &text)
+{
+  size_t done = 0;
+  while (done < text.size()) {
+    ssize_t k = ::send (fd, text.data() + done, text.size() - done,
+                        MSG_NOSIGNAL);
+    if (k < 0 and errno == EINTR)
+      continue;
+    if (k <= 0)
+      return false;
+    done += k;
+  }
+  return true;
+}
+
+Peers::Peers (const Instance *instance_, int n_trials_,
+              const string &listen_address,
+              const vector<string> &peer_addresses_)
+  : instance (instance_), n (instance_->n), n_trials (n_trials_),
+    tours (n_trials_, instance_->n, MIGRATION_ALL),
+    received (n_trials_, (Solution *) NULL), evaluations (0),
+    listen_fd (-1), outbox (n_trials_), peer_addresses (peer_addresses_),
+    peer_fds (peer_addresses_.size(), -1),
+    retry_time (peer_addresses_.size())
+{
+  sockaddr_storage addr;
+  socklen_t length;
+
+  for (size_t i = 0; i < peer_addresses.size(); i++) {
+    if (!resolve (peer_addresses[i], false, addr, length)) {
+      cerr << "error: invalid peer address " << peer_addresses[i] << endl;
+      exit (EXIT_FAILURE);
+    }
+  }
+
+  if (!listen_address.empty()) {
+    if (!resolve (listen_address, true, addr, length)) {
+      cerr << "error: invalid listen address " << listen_address << endl;
+      exit (EXIT_FAILURE);
+    }
+    if (addr.ss_family == AF_UNIX)
+      unlink (((sockaddr_un &) addr).sun_path);
+
+    int on = 1;
+    listen_fd = socket (addr.ss_family, SOCK_STREAM, 0);
+    if (listen_fd < 0
+        or setsockopt (listen_fd, SOL_SOCKET, SO_REUSEADDR,
+                       &on, sizeof (on)) < 0
+        or bind (listen_fd, (sockaddr *) &addr, length) < 0
+        or listen (listen_fd, 16) < 0) {
+      cerr << "error: cannot listen on " << listen_address << ": "
+           << strerror (errno) << endl;
+      exit (EXIT_FAILURE);
+    }
+  }
+
+  if (pipe (stop_pipe) < 0 or pipe (send_pipe) < 0) {
+    cerr << "error: pipe: " << strerror (errno) << endl;
+    exit (EXIT_FAILURE);
+  }
+  // send() must not block, even if the pipe is full.
+  fcntl (send_pipe[1], F_SETFL, fcntl (send_pipe[1], F_GETFL) | O_NONBLOCK);
+  receiver = thread (&Peers::receive_loop, this);
+}
+
+Peers::~Peers ()
+{
+  char c = 0;
+  if (write (stop_pipe[1], &c, 1) < 0)
+    perror ("write");
+  receiver.join();
+
+  close (stop_pipe[0]);
+  close (stop_pipe[1]);
+  close (send_pipe[0]);
+  close (send_pipe[1]);
+  if (listen_fd >= 0)
+    close (listen_fd);
+  for (size_t i = 0; i < peer_fds.size(); i++)
+    if (peer_fds[i] >= 0)
+      close (peer_fds[i]);
+  for (size_t i = 0; i < received.size(); i++)
+    delete received[i];
+}
+
+void
+Peers::send (int trial, const vector<int> &tour)
+{
+  string line = "tour " + to_string (trial);
+  for (size_t k = 1; k + 1 < tour.size(); k++)
+    line += " " + to_string (tour[k]);
+  line += "\n";
+
+  {
+    lock_guard<mutex> guard (send_lock);
+    outbox[trial - 1].swap (line);
+  }
+  // If the pipe is full, the receiver thread is already awake.
+  char c = 0;
+  if (write (send_pipe[1], &c, 1) < 0 and errno != EAGAIN)
+    perror ("write");
+}
+
+/* Send the queued tours to all peers. Connecting to a peer that cannot
+   be reached takes up to one second, so it is only tried again after
+   retry_seconds. Tours sent in the meantime are lost for that peer.  */
+void
+Peers::send_queued (void)
+{
+  vector<string> lines (n_trials);
+  {
+    lock_guard<mutex> guard (send_lock);
+    lines.swap (outbox);
+  }
+  bool any = false;
+  for (int t = 0; t < n_trials; t++)
+    any = any or !lines[t].empty();
+  if (!any)
+    return;
+
+  chrono::steady_clock::time_point now = chrono::steady_clock::now();
+  for (size_t i = 0; i < peer_addresses.size(); i++) {
+    if (peer_fds[i] < 0 and now >= retry_time[i]) {
+      peer_fds[i] = connect_to (peer_addresses[i]);
+      if (peer_fds[i] < 0)
+        retry_time[i] = chrono::steady_clock::now()
+          + chrono::seconds (retry_seconds);
+    }
+    for (int t = 0; t < n_trials and peer_fds[i] >= 0; t++) {
+      if (!lines[t].empty() and !write_all (peer_fds[i], lines[t])) {
+        close (peer_fds[i]);
+        peer_fds[i] = -1;
+      }
+    }
+  }
+}
+
+/* Wait for connections from peers and for their tours, and send the
+   tours queued by send(), until the destructor writes to stop_pipe.
+   Tours queued by then are still sent.  */
+void
+Peers::receive_loop (void)
+{
+  vector<int> fds;
+  vector<string> pending;
+  const size_t max_line = max_line_per_node * (n + 4);
+
+  while (true) {
+    vector<pollfd> p;
+    p.push_back (poll_in (stop_pipe[0]));
+    p.push_back (poll_in (send_pipe[0]));
+    if (listen_fd >= 0)
+      p.push_back (poll_in (listen_fd));
+    const size_t first = p.size();
+    for (size_t k = 0; k < fds.size(); k++)
+      p.push_back (poll_in (fds[k]));
+
+    if (poll (&p[0], p.size(), -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      perror ("poll");
+      break;
+    }
+    if (p[1].revents) {
+      char buffer[64];
+      if (read (send_pipe[0], buffer, sizeof (buffer)) < 0 and errno != EINTR)
+        perror ("read");
+      send_queued ();
+    }
+    if (p[0].revents) {
+      send_queued ();
+      break;
+    }
+
+    for (size_t k = 0; k < fds.size(); k++) {
+      if (!p[first + k].revents)
+        continue;
+      char buffer[4096];
+      ssize_t count = read (fds[k], buffer, sizeof (buffer));
+      if (count < 0 and errno == EINTR)
+        continue;
+
+      bool drop = (count <= 0);
+      if (!drop) {
+        pending[k].append (buffer, count);
+        size_t start = 0, end;
+        while ((end = pending[k].find ('\n', start)) != string::npos) {
+          receive_line (pending[k].substr (start, end - start));
+          start = end + 1;
+        }
+        pending[k].erase (0, start);
+        // A peer that does not follow the protocol is dropped.
+        drop = (pending[k].size() > max_line);
+      }
+      if (drop) {
+        close (fds[k]);
+        fds[k] = -1;
+      }
+    }
+    for (size_t k = fds.size(); k-- > 0; ) {
+      if (fds[k] < 0) {
+        fds.erase (fds.begin() + k);
+        pending.erase (pending.begin() + k);
+      }
+    }
+
+    if (listen_fd >= 0 and (p[2].revents & POLLIN)) {
+      int fd = accept (listen_fd, NULL, NULL);
+      if (fd >= 0) {
+        fds.push_back (fd);
+        pending.push_back (string());
+      }
+    }
+  }
+
+  for (size_t k = 0; k < fds.size(); k++)
+    close (fds[k]);
+}
+
+/* Keep the tour in line if it is valid and better than the best tour
+   received for its trial. The tour is evaluated here, so a peer cannot
+   make its tours look better than they are.  */
+void
+Peers::receive_line (const string &line)
+{
+  istringstream in (line);
+  string word;
+  int trial;
+  if (!(in >> word >> trial)
+      or word != "tour" or trial < 1 or trial > n_trials)
+    return;
+
+  vector<int> tour (1, 0);
+  vector<bool> visited (n, false);
+  int node;
+  while (in >> node) {
+    if (node < 1 or node >= n or visited[node])
+      return;
+    visited[node] = true;
+    tour.push_back (node);
+  }
+  if (!in.eof() or int (tour.size()) != n)
+    return;
+  tour.push_back (0);
+
+  Solution *s = new Solution (instance, &evaluations);
+  s->add (&tour[1]);
+  Solution *&best = received[trial - 1];
+  if (best != NULL and !s->better_than (best)) {
+    delete s;
+    return;
+  }
+  delete best;
+  best = s;
+  tours.publish (trial - 1, tour);
+}
@@ -0,0 +1,110 @@
+/*************************************************************************
+
+ Beam-ACO
+
+ ---------------------------------------------------------------------
+
+                       Copyright (c) 2008
+                  Christian Blum <christian.blum@ehu.es>
+             Manuel Lopez-Ibanez <manuel.lopez-ibanez@manchester.ac.uk>
+
+ This program is free software (software libre); you can redistribute
+ it and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2 of the
+ License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, you can obtain a copy of the GNU
+ General Public License at: http://www.gnu.org/licenses/gpl.html
+
+*************************************************************************/
+
+#ifndef PEERS_H
+#define PEERS_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include "migration.h"
+#include "tsptw_solution.h"
+
+/* Other processes running Beam-ACO on the same instance, with which
+   the best tour of each trial is exchanged.
+
+   Each process may listen on an address and sends its tours to the
+   addresses of its peers. An address is either HOST:PORT (TCP) or
+   unix:PATH (Unix socket). A tour is sent as one line of text
+
+     tour TRIAL NODE ...
+
+   with the customers in the order they are visited, without the depot.
+   A thread receives the tours of the peers, evaluates them and keeps
+   the best one of each trial, where solvers read it without locking.
+   The same thread sends the tours of the solvers, so that a slow peer
+   never holds up a solver. Peers that are not running yet, or have
+   stopped running, are skipped for a while.  */
+class Peers
+{
+public:
+  Peers (const Instance *instance, int n_trials,
+         const std::string &listen_address,
+         const std::vector<std::string> &peer_addresses);
+  ~Peers ();
+
+  /* Send tour, from depot to depot, to all peers. It is only queued
+     here, and replaces a tour of the same trial not sent yet.  */
+  void send (int trial, const std::vector<int> &tour);
+
+  /* Copy into tour the best tour of trial received from the peers, if
+     it was received after version seen, which is then updated.  */
+  bool receive (int trial, std::vector<int> &tour,
+                unsigned long &seen) const {
+    return tours.receive (trial - 1, tour, seen);
+  }
+
+private:
+  const Instance *instance;
+  int n;
+  int n_trials;
+  // One slot per trial, only written by the receiver thread.
+  Migration tours;
+  // Best tour received for each trial, only used by the receiver thread.
+  std::vector<Solution*> received;
+  std::atomic<unsigned int> evaluations;
+
+  int listen_fd;
+  int stop_pipe[2];
+  // Written to by send() to wake up the receiver thread.
+  int send_pipe[2];
+  std::thread receiver;
+
+  // The line of the last tour of each trial not sent yet, or empty.
+  std::vector<std::string> outbox;
+  std::mutex send_lock;  // Protects outbox.
+
+  // Only used by the receiver thread.
+  std::vector<std::string> peer_addresses;
+  std::vector<int> peer_fds;
+  // A peer that cannot be reached is not tried again before this time.
+  std::vector<std::chrono::steady_clock::time_point> retry_time;
+
+  void receive_loop (void);
+  void receive_line (const std::string &line);
+  void send_queued (void);
+
+  Peers (const Peers &);
+  Peers & operator= (const Peers &);
+};
+
+#endif
+// Local Variables: 
+// mode: c++; 
+// End:
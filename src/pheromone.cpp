@@ -0,0 +1,128 @@
+/*************************************************************************
+
+ Beam-ACO
+
+ ---------------------------------------------------------------------
+
+                       Copyright (c) 2008
+                  Christian Blum <christian.blum@ehu.es>
+             Manuel Lopez-Ibanez <manuel.lopez-ibanez@manchester.ac.uk>
+
+ This program is free software (software libre); you can redistribute
+ it and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2 of the
+ License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, you can obtain a copy of the GNU
+ General Public License at: http://www.gnu.org/licenses/gpl.html
+
+*************************************************************************/
+
+
+#include "pheromone.h"
+#include <algorithm>
+
+Pheromone::Pheromone (void)
+  : step (0), reset_step (0), reset_value (0.0),
+    rate (0.0), tau_min (0.0), tau_max (1.0)
+{
+}
+
+void
+Pheromone::init (int n, double value)
+{
+  values = Matrix<double> (n, n);
+  row_step.assign (n, 0);
+  row_sum.assign (n, 0.0);
+  pending.assign (n, std::vector<std::pair<int, double> > ());
+  step = reset_step = 1;
+  reset_value = value;
+}
+
+void
+Pheromone::set_parameters (double rate_, double tau_min_, double tau_max_)
+{
+  rate = rate_;
+  tau_min = tau_min_;
+  tau_max = tau_max_;
+}
+
+/* A new step that only sets the entries, so that rows brought up to
+   date before it are stale.  */
+void
+Pheromone::reset (double value)
+{
+  reset_step = ++step;
+  reset_value = value;
+}
+
+void
+Pheromone::evaporate (const deposits_t &d)
+{
+  // Rows with deposits must be up to date before this step.
+  for (size_t k = 0; k < d.size(); k++) {
+    int i = d[k].first.first;
+    if (row_step[i] != step)
+      update_row (i);
+  }
+  step++;
+  for (size_t k = 0; k < d.size(); k++)
+    pending[d[k].first.first].push_back
+      (std::make_pair (d[k].first.second, d[k].second));
+}
+
+void
+Pheromone::update_row (int i)
+{
+  const int n = values.cols();
+  double *r = values[i];
+
+  if (row_step[i] < reset_step) {
+    double p = reset_value;
+    for (unsigned int m = reset_step; m < step; m++) {
+      p = p - rate * p;
+      if (p > tau_max) p = tau_max;
+      if (p < tau_min) p = tau_min;
+    }
+    std::fill (r, r + n, p);
+  } else {
+    for (unsigned int m = row_step[i]; m < step; m++) {
+      for (int j = 0; j < n; j++) {
+        double p = r[j] - rate * r[j];
+        if (p > tau_max) p = tau_max;
+        if (p < tau_min) p = tau_min;
+        r[j] = p;
+      }
+      if (m == row_step[i]) {
+        for (size_t k = 0; k < pending[i].size(); k++)
+          r[pending[i][k].first] = pending[i][k].second;
+      }
+    }
+  }
+  pending[i].clear();
+
+  double s = 0.0;
+  for (int j = 0; j < n; j++)
+    s = s + ((tau_max - r[j] > r[j] - tau_min)
+             ? tau_max - r[j] : r[j] - tau_min);
+  row_sum[i] = s;
+  row_step[i] = step;
+}
+
+double
+Pheromone::convergence_sum (void)
+{
+  double s = 0.0;
+  for (size_t i = 0; i < row_step.size(); i++) {
+    if (row_step[i] != step)
+      update_row (i);
+    s = s + row_sum[i];
+  }
+  return s;
+}
@@ -0,0 +1,106 @@
+/*************************************************************************
+
+ Beam-ACO
+
+ ---------------------------------------------------------------------
+
+                       Copyright (c) 2008
+                  Christian Blum <christian.blum@ehu.es>
+             Manuel Lopez-Ibanez <manuel.lopez-ibanez@manchester.ac.uk>
+
+ This program is free software (software libre); you can redistribute
+ it and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2 of the
+ License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, you can obtain a copy of the GNU
+ General Public License at: http://www.gnu.org/licenses/gpl.html
+
+*************************************************************************/
+
+
+#ifndef PHEROMONE_H
+#define PHEROMONE_H
+
+#include <cassert>
+#include <vector>
+#include <utility>
+#include "matrix.h"
+
+/* Pheromone matrix with lazy evaporation.
+
+   Every iteration evaporates all entries, tau = tau - rate * tau
+   clamped to [tau_min, tau_max], and then sets the values of the edges
+   of a few solutions. evaporate() and reset() only record this: each
+   row remembers the step at which it was last brought up to date, and
+   the deposits of the last step into it. A stale row is brought up to
+   date when it is read by row(), which the construction of the next
+   iteration does anyway, so the matrix is only walked once per
+   iteration. The convergence term of the row is taken in the same
+   pass.
+
+   row() writes a stale row, so rows may only be read concurrently once
+   they are all up to date, and then with operator[].  */
+class Pheromone
+{
+public:
+  typedef std::vector<std::pair<std::pair<int,int>, double> > deposits_t;
+
+  Pheromone (void);
+
+  void init (int n, double value);
+  // Only valid before the values are used, or followed by reset().
+  void set_parameters (double rate, double tau_min, double tau_max);
+
+  // Set all entries to value.
+  void reset (double value);
+
+  /* Evaporate all entries and then set the entries in d, which is
+     sorted by row, to their values.  */
+  void evaporate (const deposits_t &d);
+
+  // Row i, brought up to date first.
+  const double * row (int i) {
+    if (row_step[i] != step)
+      update_row (i);
+    return values[i];
+  }
+  double get (int i, int j) { return row (i)[j]; }
+
+  // Row i, which must be up to date.
+  const double * operator[] (int i) const {
+    assert (row_step[i] == step);
+    return values[i];
+  }
+
+  // Sum of max(tau_max - tau, tau - tau_min) over all entries.
+  double convergence_sum (void);
+
+private:
+  Matrix<double> values;
+  // Step at which row i was last brought up to date.
+  std::vector<unsigned int> row_step;
+  // Convergence term of row i, valid while it is up to date.
+  std::vector<double> row_sum;
+  // Deposits into row i at step row_step[i] + 1.
+  std::vector<std::vector<std::pair<int, double> > > pending;
+  unsigned int step;
+  // All entries were set to reset_value at reset_step.
+  unsigned int reset_step;
+  double reset_value;
+
+  double rate, tau_min, tau_max;
+
+  void update_row (int i);
+};
+
+#endif
+// Local Variables: 
+// mode: c++; 
+// End:
@@ -0,0 +1,118 @@
+/*************************************************************************
+
+ Beam-ACO
+
+ ---------------------------------------------------------------------
+
+                       Copyright (c) 2008
+                  Christian Blum <christian.blum@ehu.es>
+             Manuel Lopez-Ibanez <manuel.lopez-ibanez@manchester.ac.uk>
+
+ This program is free software (software libre); you can redistribute
+ it and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2 of the
+ License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, you can obtain a copy of the GNU
+ General Public License at: http://www.gnu.org/licenses/gpl.html
+
+*************************************************************************/
+
+#include "thread_pool.h"
+#include <cassert>
+
+// True in the worker threads and while the caller runs its share of a job.
+static thread_local bool in_parallel_for = false;
+
+Thread_Pool::Thread_Pool (int n_threads_)
+  : n_threads (n_threads_ < 1 ? 1 : n_threads_),
+    task (nullptr), n_tasks (0), next_task (0), busy (0),
+    generation (0), stopping (false)
+{
+  for (int i = 1; i < n_threads; i++)
+    workers.push_back (std::thread (&Thread_Pool::worker, this));
+}
+
+Thread_Pool::~Thread_Pool ()
+{
+  {
+    std::unique_lock<std::mutex> guard (lock);
+    stopping = true;
+  }
+  work_ready.notify_all();
+  for (size_t i = 0; i < workers.size(); i++)
+    workers[i].join();
+}
+
+void
+Thread_Pool::run (void)
+{
+  size_t i;
+  while ((i = next_task++) < n_tasks)
+    (*task) (i);
+}
+
+bool
+Thread_Pool::in_task (void)
+{
+  return in_parallel_for;
+}
+
+void
+Thread_Pool::worker (void)
+{
+  in_parallel_for = true;
+  unsigned long seen = 0;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> guard (lock);
+      work_ready.wait (guard, [&] { return stopping || generation != seen; });
+      if (stopping) return;
+      seen = generation;
+    }
+    run();
+    {
+      std::unique_lock<std::mutex> guard (lock);
+      if (--busy == 0)
+        work_done.notify_one();
+    }
+  }
+}
+
+void
+Thread_Pool::parallel_for (size_t n, const std::function<void (size_t)> &f)
+{
+  if (n_threads == 1 || n <= 1 || in_parallel_for || !job_lock.try_lock()) {
+    for (size_t i = 0; i < n; i++)
+      f (i);
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> guard (lock);
+    task = &f;
+    n_tasks = n;
+    next_task = 0;
+    busy = n_threads - 1;
+    generation++;
+  }
+  work_ready.notify_all();
+
+  in_parallel_for = true;
+  run();
+  in_parallel_for = false;
+
+  {
+    std::unique_lock<std::mutex> guard (lock);
+    work_done.wait (guard, [&] { return busy == 0; });
+    task = nullptr;
+  }
+  job_lock.unlock();
+}
@@ -0,0 +1,85 @@
+/*************************************************************************
+
+ Beam-ACO
+
+ ---------------------------------------------------------------------
+
+                       Copyright (c) 2008
+                  Christian Blum <christian.blum@ehu.es>
+             Manuel Lopez-Ibanez <manuel.lopez-ibanez@manchester.ac.uk>
+
+ This program is free software (software libre); you can redistribute
+ it and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2 of the
+ License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, you can obtain a copy of the GNU
+ General Public License at: http://www.gnu.org/licenses/gpl.html
+
+*************************************************************************/
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+/* A fixed set of worker threads that run the iterations of a loop.
+
+   parallel_for() blocks until all iterations are done and the calling
+   thread runs iterations too, so a pool of size N uses N - 1 extra
+   threads. Iterations are handed out one at a time, so they may run
+   in any order and on any thread: results must be written to slots
+   indexed by the iteration to be reproducible.
+
+   A call from inside an iteration, or while another thread is using
+   the pool, runs the loop serially in the calling thread.  */
+class Thread_Pool
+{
+public:
+  explicit Thread_Pool (int n_threads);
+  ~Thread_Pool ();
+
+  int size (void) const { return n_threads; }
+
+  void parallel_for (size_t n, const std::function<void (size_t)> &task);
+
+  // Is the calling thread running an iteration of a parallel loop?
+  static bool in_task (void);
+
+private:
+  int n_threads;
+  std::vector<std::thread> workers;
+
+  std::mutex job_lock;  // Held by the thread that owns the current job.
+  std::mutex lock;      // Protects the fields below.
+  std::condition_variable work_ready;
+  std::condition_variable work_done;
+  const std::function<void (size_t)> *task;
+  size_t n_tasks;
+  std::atomic<size_t> next_task;
+  int busy;
+  unsigned long generation;
+  bool stopping;
+
+  void worker (void);
+  void run (void);
+
+  Thread_Pool (const Thread_Pool &);
+  Thread_Pool & operator= (const Thread_Pool &);
+};
+
+#endif
+// Local Variables: 
+// mode: c++; 
+// End:
@@ -35,45 +35,10 @@
 
 #include "tsptw_solution.h"
 
-string Solution::instance;
-
-// number of customers
-int Solution::n = 0;
-
-unsigned int Solution::evaluations = 0;
-
-// time-window start
-vector<number_t> Solution::window_start;
-number_t Solution::window_start_min = NUMBER_T_MAX; 
-number_t Solution::window_start_max = NUMBER_T_MIN; 
-
-// time-window end
-vector<number_t> Solution::window_end;
-number_t Solution::window_end_min =  NUMBER_T_MAX;
-number_t Solution::window_end_max =  NUMBER_T_MIN;
-
-// travel time/distance
-vector<vector<number_t> > Solution::distance;
-number_t Solution::distance_min =  NUMBER_T_MAX; 
-number_t Solution::distance_max =  NUMBER_T_MIN; 
-
-vector<vector<double> > Solution::heuristic_info;
-
-bool Solution::is_symmetric;
-
-#if DEBUG>=1
-bool Solution::heuristic_info_ready = false;
-#endif
-
-vector<vector<bool> > Solution::tw_infeasible;
-int Solution::num_tw_infeasible = 0;
-
 heuristic_type_t Solution::heuristic_type = EARLIEST_WINDOW_END;
 localsearch_type_t Solution::localsearch_type = LOCALSEARCH_NONE;
 
-double Solution::dist_heuristic_weight = 0.0;
-double Solution::winstart_heuristic_weight = 0.0;
-double Solution::winend_heuristic_weight = 0.0;
+hinfo_weights_t Solution::heuristic_weights = { 0.0, 0.0, 0.0, true };
 
 bool
 Solution::set_heuristic_weights (char *arg)
@@ -108,9 +73,10 @@ Solution::set_heuristic_weights (char *arg)
 
   if (total < 1e-6) return true;
 
-  dist_heuristic_weight = dist_w / total;
-  winstart_heuristic_weight = winstart_w / total;
-  winend_heuristic_weight = winend_w / total;
+  heuristic_weights.distance = dist_w / total;
+  heuristic_weights.window_start = winstart_w / total;
+  heuristic_weights.window_end = winend_w / total;
+  heuristic_weights.uniform = false;
 
   return true;
 }
@@ -122,9 +88,9 @@ Solution::get_heuristic_type(void)
 
   static char buf[100];
   sprintf (buf, "%.5f %.5f %.5f",
-           dist_heuristic_weight,
-           winstart_heuristic_weight,
-           winend_heuristic_weight);
+           heuristic_weights.distance,
+           heuristic_weights.window_start,
+           heuristic_weights.window_end);
   return buf;
 }
 
@@ -135,12 +101,13 @@ Solution::get_localsearch_type(void)
     case LOCALSEARCH_NONE:  return "none";
     case LOCALSEARCH_FIRST: return "first";
     case LOCALSEARCH_BEST:  return "best";
+    case LOCALSEARCH_OROPT: return "oropt";
     default: abort();
   }
 }
 
 void
-Solution::calculate_static_hinfo(void)
+Instance::calculate_static_hinfo(void)
 {
   // Calculate normalisation bounds.
   for (int i = 0; i < n; i++) {
@@ -167,42 +134,10 @@ Solution::calculate_static_hinfo(void)
     }
   }
 
-  // Pre-compute heuristic_info.
-  /*
-  for (int i = 0; i < n; i++) {
-    for (int j = 0; j < n; j++) {
-      heuristic_info[i][j] = weighted_hinfo (i, j,
-                                             dist_heuristic_weight,
-                                             winstart_heuristic_weight,
-                                             winend_heuristic_weight);
-    }
-  }
-  DEBUG1(Solution::heuristic_info_ready = true);
-  */
- 
-}
-
-double
-Solution::weighted_hinfo (int prev, int next,
-                          double dist_w, 
-                          double winstart_w, 
-                          double winend_w)
-{
-  if (prev == next) return 0.0;
-
-  if (dist_w < 1e-6
-      and winstart_w < 1e-6
-      and winend_w < 1e-6)
-    return 1.;
+  /* Pre-compute the normalised components of the heuristic
+     information, which only depend on the instance.
 
-  /* ??? We cannot return zero here because this might be the only
-     remaining option for an ant. It would be better to return zero
-     here and if the ant does no have any option with higher than zero
-     desirability, then choose between the options with zero
-     desirability.  */
-  //if (tw_infeasible[prev][next]) return 1e-6;
-
-  /* Normalisation:
+     Normalisation:
 
      [orig_min, orig_max] -> [nor_min, nor_max] :
 
@@ -221,74 +156,85 @@ Solution::weighted_hinfo (int prev, int next,
   (nor_min + (nor_max - nor_min)                                   \
    * (((ORIG_MAX) - (ORIG)) / (double)(ORIG_MAX - ORIG_MIN)))
 
-  double h_dist =
-    NORMALISE_INV (distance[prev][next], distance_min, distance_max);
-  double h_win_start =
-    NORMALISE_INV (window_start[next], window_start_min, window_start_max);
-  double h_win_end =
-    NORMALISE_INV (window_end[next], window_end_min, window_end_max);
+  hinfo_distance = Matrix<double> (n, n);
+  hinfo_window_start.resize (n);
+  hinfo_window_end.resize (n);
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j < n; j++) {
+      hinfo_distance[i][j] =
+        NORMALISE_INV (distance[i][j], distance_min, distance_max);
+    }
+    hinfo_window_start[i] =
+      NORMALISE_INV (window_start[i], window_start_min, window_start_max);
+    hinfo_window_end[i] =
+      NORMALISE_INV (window_end[i], window_end_min, window_end_max);
+  }
 
 #undef nor_min
 #undef nor_max
 #undef NORMALISE_INV
+}
 
-  double h_final = dist_w * h_dist 
-    + winstart_w * h_win_start 
-    + winend_w * h_win_end;
-
-#if DEBUG > 2
-    fprintf (stderr, "D[%3d][%3d] = %.2f,  Ws[%3d] = %.2f, We[%3d], = %.2f"
-    "  H(D) = %.5f, H(Ws) = %.5f, H(We) = %.5f  H = %.5f\n",
-             prev, next, (double)distance[prev][next],
-    next, (double)window_start[next],
-    next, (double)window_end[next],
-    h_dist, h_win_start, h_win_end, h_final);
-#endif
+/* Store in out[j] the product of scale[j] and the heuristic information
+   of going from prev to j with weights w, for all j.  */
+void
+Instance::heuristic_information_times (const hinfo_weights_t &w, int prev,
+                                       const double *scale, double *out) const
+{
+  if (w.uniform) {
+    for (int j = 0; j < n; j++)
+      out[j] = scale[j];
+  } else {
+    const double dist_w = w.distance;
+    const double winstart_w = w.window_start;
+    const double winend_w = w.window_end;
+    const double *h_dist = hinfo_distance[prev];
+    const double *h_win_start = &hinfo_window_start[0];
+    const double *h_win_end = &hinfo_window_end[0];
 
-  return h_final;
+    for (int j = 0; j < n; j++) {
+      double h = dist_w * h_dist[j]
+        + winstart_w * h_win_start[j]
+        + winend_w * h_win_end[j];
+      out[j] = scale[j] * h;
+    }
+  }
+  out[prev] = 0.0;
 }
 
-void
-Solution::randomize_hinfo (Random *rng)
+hinfo_weights_t
+Solution::random_hinfo_weights (Random *rng)
 {
+  hinfo_weights_t w;
   double dist_w = rng->next();
   double winstart_w = rng->next();
   double winend_w = rng->next();
   double total = dist_w + winstart_w + winend_w;
 
   if (total < 1e-6) {
-    dist_heuristic_weight = 0.0;
-    winstart_heuristic_weight = 0.0;
-    winend_heuristic_weight = 0.0;
+    w.distance = 0.0;
+    w.window_start = 0.0;
+    w.window_end = 0.0;
   }
   else  {
-    dist_heuristic_weight = dist_w / total;
-    winstart_heuristic_weight = winstart_w / total;
-    winend_heuristic_weight = winend_w / total;
+    w.distance = dist_w / total;
+    w.window_start = winstart_w / total;
+    w.window_end = winend_w / total;
   }
 
-  // Pre-compute heuristic_info.
-  for (int i = 0; i < n; i++) {
-    for (int j = 0; j < n; j++) {
-      heuristic_info[i][j] = weighted_hinfo (i, j,
-                                             dist_heuristic_weight,
-                                             winstart_heuristic_weight,
-                                             winend_heuristic_weight);
-    }
-  }
-
-  DEBUG1 (Solution::heuristic_info_ready = true);
+  w.uniform = (w.distance < 1e-6
+               and w.window_start < 1e-6
+               and w.window_end < 1e-6);
 
 #if DEBUG >= 2
   fprintf (stderr, "weights: %.5f %.5f %.5f\n", 
-           dist_heuristic_weight,
-           winstart_heuristic_weight,
-           winend_heuristic_weight);
+           w.distance, w.window_start, w.window_end);
 #endif
+  return w;
 }
 
 static bool
-matrix_is_symmetric(vector<vector<number_t> > &x, int n)
+matrix_is_symmetric(const Matrix<number_t> &x, int n)
 {
     for (int i = 0; i < n; i++) {
         for (int j = i+1; j < n; j++) {
@@ -298,17 +244,20 @@ matrix_is_symmetric(vector<vector<number_t> > &x, int n)
     return true;
 }
 #if 1
-void
-Solution::LoadInstance (string filename)
+Instance::Instance (string filename, int candidate_list_size)
+  : filename (filename), n (0),
+    window_start_min (NUMBER_T_MAX), window_start_max (NUMBER_T_MIN),
+    window_end_min (NUMBER_T_MAX), window_end_max (NUMBER_T_MIN),
+    distance_min (NUMBER_T_MAX), distance_max (NUMBER_T_MIN),
+    num_tw_infeasible (0), candidate_list_size (0)
 {
   ifstream indata;
   number_t rtime;
   number_t ddate;
 
-  instance = filename;
-  indata.open (instance.c_str());
+  indata.open (filename.c_str());
   if (!indata) { // file couldn't be opened
-    cerr << "error:LoadInstance(): file " << instance.c_str() << " could not be opened"
+    cerr << "error:LoadInstance(): file " << filename.c_str() << " could not be opened"
          << endl;
     exit (EXIT_FAILURE);
   }
@@ -322,10 +271,9 @@ Solution::LoadInstance (string filename)
 
   window_start.reserve(n);
   window_end.reserve(n);
-  distance.reserve(n);
+  distance = Matrix<number_t> (n, n, 0);
 
   for (int i = 0 ; i < n; i++) {
-    distance.push_back(vector<number_t>(n,0));
     for (int j = 0; j < n; j++) {
         indata >> distance[i][j];
     }
@@ -353,15 +301,17 @@ Solution::LoadInstance (string filename)
 
   strong_time_window_infeasibility();
 
-  heuristic_info.reserve(n);
-  for (int i = 0; i < n; i++)
-    heuristic_info.push_back (vector<double>(n));
-
   calculate_static_hinfo ();
+  build_candidate_lists (candidate_list_size);
+  init_zobrist ();
 }
 #else
-void
-Solution::LoadInstance (string filename)
+Instance::Instance (string filename, int candidate_list_size)
+  : filename (filename), n (0),
+    window_start_min (NUMBER_T_MAX), window_start_max (NUMBER_T_MIN),
+    window_end_min (NUMBER_T_MAX), window_end_max (NUMBER_T_MIN),
+    distance_min (NUMBER_T_MAX), distance_max (NUMBER_T_MIN),
+    num_tw_infeasible (0), candidate_list_size (0)
 {
   int k, s;
   char buffer[1024];
@@ -370,10 +320,9 @@ Solution::LoadInstance (string filename)
   number_t ddate;
   vector<number_t> service;
 
-  instance = filename;
-  indata.open (instance.c_str());
+  indata.open (filename.c_str());
   if (!indata) { // file couldn't be opened
-    cerr << "error: file " << instance.c_str() << " could not be opened"
+    cerr << "error: file " << filename.c_str() << " could not be opened"
          << endl;
     exit (EXIT_FAILURE);
   }
@@ -391,7 +340,7 @@ Solution::LoadInstance (string filename)
   //  fprintf (stderr, "n = %d", n);
   window_start.reserve(n);
   window_end.reserve(n);
-  distance.reserve(n);
+  distance = Matrix<number_t> (n, n, 0);
   distance_s.reserve(n);
   service.reserve(n);
 
@@ -406,7 +355,6 @@ Solution::LoadInstance (string filename)
     service.push_back(s);
     window_start.push_back (rtime);
     window_end.push_back(ddate);
-    distance.push_back(vector<number_t>(n,0));
     distance_s.push_back(vector<number_t>(n,0));
   }
 
@@ -435,22 +383,17 @@ Solution::LoadInstance (string filename)
 
   strong_time_window_infeasibility();
 
-  heuristic_info.reserve(n);
-  for (int i = 0; i < n; i++)
-    heuristic_info.push_back (vector<double>(n));
-
   calculate_static_hinfo ();
 }
 #endif
 
 void
-Solution::strong_time_window_infeasibility()
+Instance::strong_time_window_infeasibility()
 {
-  tw_infeasible.reserve(n);
+  tw_infeasible = Matrix<unsigned char> (n, n);
   num_tw_infeasible = 0;
   
   for (int i = 0 ; i < n; ++i) {
-    tw_infeasible.push_back (vector<bool>(n));
     for (int j = 0; j < n; ++j) {
       tw_infeasible[i][j] =  (window_start[i] + distance[i][j] > window_end[j])
           ? (++num_tw_infeasible, true) : false;
@@ -458,6 +401,73 @@ Solution::strong_time_window_infeasibility()
   }
 }
 
+/* The keys are fixed, so hashes do not depend on the random seed.  */
+void
+Instance::init_zobrist (void)
+{
+  uint64_t z = 0;
+  zobrist.resize (n);
+  zobrist[0] = 0;
+  for (int i = 1; i < n; i++) {
+    // splitmix64
+    z += 0x9E3779B97F4A7C15ULL;
+    uint64_t x = z;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    zobrist[i] = x ^ (x >> 31);
+  }
+}
+
+/* Candidates of i are ranked by the least time between leaving i and
+   serving them, which is the travel time plus any wait for the window
+   to open. Customers that can never be reached in time after i go
+   last. The depot is never a candidate.  */
+void
+Instance::build_candidate_lists (int length)
+{
+  int size = min (length, n - 2);
+  if (size <= 0) {
+    candidate_list = Matrix<int> ();
+    candidate_list_size = 0;
+    return;
+  }
+
+  vector<pair<pair<bool,number_t>,int> > order;
+  candidate_list = Matrix<int> (n, size);
+  for (int i = 0; i < n; i++) {
+    order.clear();
+    for (int j = 1; j < n; j++) {
+      if (j == i) continue;
+      number_t gap = max (distance[i][j], window_start[j] - window_end[i]);
+      order.push_back (make_pair (make_pair (bool(tw_infeasible[i][j]), gap),
+                                  j));
+    }
+    partial_sort (order.begin(), order.begin() + size, order.end());
+    for (int k = 0; k < size; k++)
+      candidate_list[i][k] = order[k].second;
+  }
+  candidate_list_size = size;
+}
+
+/* Store in out the unassigned candidates of last, in the order of the
+   list, that can be reached from last before the end of their time
+   window, and return how many there are.  */
+int
+Solution::feasible_candidates (int last, vector<int> &out) const
+{
+  const int size = instance->candidate_list.cols();
+  const int *list = instance->candidate_list[last];
+  const number_t now = _makespan[permutation.size() - 1];
+
+  out.clear();
+  for (int k = 0; k < size; k++) {
+    int j = list[k];
+    if (!node_assigned[j] and now + instance->distance[last][j] <= instance->window_end[j])
+      out.push_back (j);
+  }
+  return out.size();
+}
+
 void
 Solution::print_compile_parameters (FILE *stream)
 {
@@ -475,13 +485,13 @@ Solution::print_compile_parameters (FILE *stream)
 }
 
 void
-Solution::print_parameters (string prefix, FILE *stream)
+Instance::print_parameters (string prefix, FILE *stream) const
 {
   fprintf (stream, "%s Problem: ", prefix.c_str());
-  print_compile_parameters (stream);
+  Solution::print_compile_parameters (stream);
   fprintf (stream, "\n");
 
-  fprintf (stream, "%s instance : %s\n", prefix.c_str(), instance.c_str());
+  fprintf (stream, "%s instance : %s\n", prefix.c_str(), filename.c_str());
   fprintf (stream, "%s n. customers + depot: %d\n", prefix.c_str(), n);
   fprintf (stream, "%s distances   : [%g, %g]\n", prefix.c_str(), (double) distance_min, (double) distance_max);
   fprintf (stream, "%s window_start: [%g, %g]\n", prefix.c_str(), (double) window_start_min, (double) window_start_max);
@@ -489,6 +499,7 @@ Solution::print_parameters (string prefix, FILE *stream)
   fprintf (stream, "%s n tw infeasible : %d (%g%%)\n", prefix.c_str(), num_tw_infeasible, 
            double(100.0*num_tw_infeasible/(n*n)));
   fprintf (stream, "%s symmetric : %s\n", prefix.c_str(), is_symmetric ? "true" : "false");
+  fprintf (stream, "%s candidate list size : %d\n", prefix.c_str(), int(candidate_list.cols()));
 }
 
 void Solution::print_one_line() const
@@ -525,29 +536,29 @@ void Solution::print_verbose (FILE *stream = stdout) const
   
 #define TSPTW_VERBOSE_PRINT(NODE1,NODE2, INDEX)                                \
   do {                                                                         \
-      d = distance[(NODE1)][(NODE2)];                                          \
+      d = instance->distance[(NODE1)][(NODE2)];                                          \
       cost += d;                                                               \
-      departure = max (mkspan + d, window_start[(NODE2)]);                     \
-      waiting = window_start[(NODE2)] - (mkspan + d);                          \
+      departure = max (mkspan + d, instance->window_start[(NODE2)]);                     \
+      waiting = instance->window_start[(NODE2)] - (mkspan + d);                          \
       waiting = waiting >= 0 ? waiting                                         \
-          : min (0, window_end[(NODE2)] - departure);                          \
+          : min (0, instance->window_end[(NODE2)] - departure);                          \
                                                                                \
       fprintf (stream, " D[%2d][%2d] = %7g, tour cost = %8.2f, "               \
                " window = [%7g, %7g], waiting = %8.2f, makespan = %8.2f "      \
                " [%8.2f]\n",                                                   \
                (NODE1), (NODE2),                                               \
                double(d), double(cost),                                        \
-               (double)window_start[(NODE2)], (double)window_end[(NODE2)],     \
+               (double)instance->window_start[(NODE2)], (double)instance->window_end[(NODE2)],     \
                (double) waiting, (double) departure, (double) _makespan[INDEX]); \
       mkspan = departure;                                                      \
   } while (0)
   
 
-  for (int i = 1; i < n; i++) {
+  for (int i = 1; i < instance->n; i++) {
       TSPTW_VERBOSE_PRINT(permutation[i - 1], permutation[i], i);
   }
 
-  TSPTW_VERBOSE_PRINT(permutation[n - 1], 0, n);
+  TSPTW_VERBOSE_PRINT(permutation[instance->n - 1], 0, instance->n);
 
 #undef TSPTW_VERBOSE_PRINT
 
@@ -588,6 +599,15 @@ int Solution::constraint_violations() const
 }
 
 void Solution::add(int current, int node)
+{
+  *evaluations += append (current, node);
+}
+
+/* Add node after current, and the last node and the depot if only one
+   node is then left, without counting the evaluations. Return the
+   number of evaluations, so that callers that add many nodes count
+   them in a local and add them to the shared *evaluations once.  */
+unsigned int Solution::append(int current, int node)
 {
   assert (node > 0);
   assert (node != current);
@@ -596,35 +616,36 @@ void Solution::add(int current, int node)
   permutation.push_back(node);
   int j = permutation.size() - 1;
 
-  _makespan[j] = max (_makespan[j - 1] + distance[current][node],
-                      window_start[node]);
+  _makespan[j] = max (_makespan[j - 1] + instance->distance[current][node],
+                      instance->window_start[node]);
 
-  if (_makespan[j] > window_end[node]) {
-      _infeasibility += _makespan[j] - window_end[node];
+  if (_makespan[j] > instance->window_end[node]) {
+      _infeasibility += _makespan[j] - instance->window_end[node];
       _constraint_violations++;
   }
 
-  _tourcost += distance[current][node];
+  _tourcost += instance->distance[current][node];
 
+  visited_hash ^= instance->zobrist[node];
   node_assigned[node] = true;
   nodes_available--;
 
-  evaluations++;
+  unsigned int count = 1;
 
   if (nodes_available == 1) {
     current = node;
     node = 0;
     while (node_assigned[++node]);
-    add (current, node);
+    count += append (current, node);
     // This is the last node, so connect it to the depot.
     permutation.push_back (0);
-    _makespan[n] = _makespan[n-1] + distance[node][0];
-    _tourcost +=  distance[node][0];
-    if (_makespan[n] > window_end[0]) {
+    _makespan[instance->n] = _makespan[instance->n-1] + instance->distance[node][0];
+    _tourcost +=  instance->distance[node][0];
+    if (_makespan[instance->n] > instance->window_end[0]) {
       _constraint_violations++;
-      _infeasibility += _makespan[n] - window_end[0];
+      _infeasibility += _makespan[instance->n] - instance->window_end[0];
     }
-    evaluations++;
+    count++;
   }
 
   /*
@@ -634,19 +655,39 @@ void Solution::add(int current, int node)
       fprintf (stderr," %2d", i);
   fprintf(stderr, "\n");
   */
+  return count;
+}
+
+/* Store the constraint violations, makespan and tour cost that the
+   solution would have after adding node, without adding it. Adding the
+   next to last node also completes the tour, which is not accounted
+   for, so at least three nodes must be available.  */
+void Solution::evaluate_add (int node, int &cviols, number_t &mkspan,
+                             number_t &tourcost) const
+{
+  assert (nodes_available > 2);
+  assert (!node_assigned[node]);
+
+  int current = permutation.back();
+  mkspan = max (_makespan[permutation.size() - 1] + instance->distance[current][node],
+                instance->window_start[node]);
+  cviols = _constraint_violations + (mkspan > instance->window_end[node] ? 1 : 0);
+  tourcost = _tourcost + instance->distance[current][node];
 }
 
 void Solution::add (const int * p)
 {
   int last = permutation.back();
   int k = 0;
+  unsigned int count = 0;
 
   while (nodes_available) {
     int node = p[k];
-    add (last, node);
+    count += append (last, node);
     last = node;
     ++k;
   }
+  *evaluations += count;
 }
 
 void Solution::assert_solution() const
@@ -666,18 +707,18 @@ bool Solution::check_partial_solution(int max_node) const
   for (int i = 1; i < max_node; i++) {
     int node = permutation[i];
 
-    cost += distance[prev][node];
-    mkspan = max (mkspan + distance[prev][node], window_start[node]);
+    cost += instance->distance[prev][node];
+    mkspan = max (mkspan + instance->distance[prev][node], instance->window_start[node]);
     if (!fequals (mkspan, _makespan[i])) {
       fprintf (stderr, "invalid: makespan = %g !=  _makespan[%d] = %g!\n",
               double(mkspan), i, double(_makespan[i]));
       return false;
     }
     
-    if (_makespan[i] > window_end[node]) {
-      fprintf (stderr, "n = %d, i = %d, node = %d\n", n, i, node);
+    if (_makespan[i] > instance->window_end[node]) {
+      fprintf (stderr, "n = %d, i = %d, node = %d\n", instance->n, i, node);
       fprintf (stderr, "invalid: makespan[%d] = %g > tw_end[%d] = %g!\n",
-              i, double(_makespan[i]), node, double(window_end[node]));
+              i, double(_makespan[i]), node, double(instance->window_end[node]));
       return false;
     }
     prev = node;
@@ -694,9 +735,9 @@ bool Solution::check_solution() const
   int cviols_unsure = 0;
   number_t infeas = 0;
 
-  if (int(permutation.size() - 1) != n) {
+  if (int(permutation.size() - 1) != instance->n) {
       fprintf (stderr, "invalid: (permutation.size() == %d) != (n == %d)\n",
-               int(permutation.size() - 1), n);
+               int(permutation.size() - 1), instance->n);
       return false;
   }
   if (!is_a_permutation(permutation, permutation.begin(), permutation.end()-1)) {
@@ -704,57 +745,57 @@ bool Solution::check_solution() const
       return false;
   }
 
-  for (int i = 1; i < n; i++) {
+  for (int i = 1; i < instance->n; i++) {
     int node = permutation[i];
 
-    cost += distance[prev][node];
-    mkspan = max (mkspan + distance[prev][node], window_start[node]);
+    cost += instance->distance[prev][node];
+    mkspan = max (mkspan + instance->distance[prev][node], instance->window_start[node]);
     if (!fequals (mkspan, _makespan[i])) {
       fprintf (stderr, "invalid: makespan = %g !=  _makespan[%d] = %g!\n",
               double(mkspan), i, double(_makespan[i]));
       return false;
     }
     
-    if (_makespan[i] > window_end[node]) {
+    if (_makespan[i] > instance->window_end[node]) {
       cviols++;
-      infeas += _makespan[i] - window_end[node];
+      infeas += _makespan[i] - instance->window_end[node];
       /*
       fprintf (stderr, "n = %d, i = %d, node = %d\n", n, i, node);
       fprintf (stderr, "invalid: makespan[%d] = %g > tw_end[%d] = %g!\n",
               i, double(_makespan[i]), node, double(window_end[node]));
       */
     }
-    if (fequals (_makespan[i], window_end[node]))
+    if (fequals (_makespan[i], instance->window_end[node]))
       cviols_unsure++;
 
     prev = node;
   }
 
   // finish at the depot
-  cost += distance[prev][0];
+  cost += instance->distance[prev][0];
   if (!fequals (cost, _tourcost)) {
     fprintf (stderr, "invalid: real cost = %g !=  _tourcost = %g!\n",
             double(cost), double(_tourcost));
     return false;
   }
 
-  mkspan = max (mkspan + distance[prev][0], window_start[0]);
-  if (!fequals (mkspan, _makespan[n])) {
+  mkspan = max (mkspan + instance->distance[prev][0], instance->window_start[0]);
+  if (!fequals (mkspan, _makespan[instance->n])) {
     fprintf (stderr, "invalid: makespan = %g !=  _makespan[n] = %g!\n",
-            double(mkspan), double(_makespan[n]));
+            double(mkspan), double(_makespan[instance->n]));
     return false;
   }
 
-  if (_makespan[n] > window_end[0]) {
+  if (_makespan[instance->n] > instance->window_end[0]) {
       cviols++;
-      infeas += _makespan[n] - window_end[0];
+      infeas += _makespan[instance->n] - instance->window_end[0];
     /*
     fprintf (stderr, "n = %d, i = %d, node = %d\n", n, n, 0);
     fprintf (stderr, "invalid: makespan[%d] = %g > tw_end[%d] = %g!\n",
             n, double(_makespan[n]), 0, double(window_end[0]));
     */
   }
-  if (fequals (_makespan[n], window_end[0]))
+  if (fequals (_makespan[instance->n], instance->window_end[0]))
     cviols_unsure++;
 
   if (abs (cviols - _constraint_violations) > cviols_unsure) {
@@ -779,7 +820,7 @@ bool Solution::check_solution() const
 /* Exchange the customers at positions k and k+1.  */
 void Solution::swap (int k)
 {
-  assert (k < n - 1);
+  assert (k < instance->n - 1);
   assert (k > 0);
   int a = permutation[k-1];
   int b = permutation[k];
@@ -789,7 +830,7 @@ void Solution::swap (int k)
 
 #if DEBUG >= 3
   fprintf (stderr, "makespan:");
-  for (int i = 0; i < n+1; i++)
+  for (int i = 0; i < instance->n+1; i++)
     fprintf (stderr, " %g", (double)_makespan[i]);
   fprintf (stderr, "\n");
 #endif
@@ -800,81 +841,82 @@ void Solution::swap (int k)
   // solution as "dirty" so the next iteration would know that the
   // makespan is up-to-date.
 
-  if (_makespan[k] > window_end[b]) {
+  if (_makespan[k] > instance->window_end[b]) {
     _constraint_violations--;
-    _infeasibility -= (_makespan[k] - window_end[b]);
+    _infeasibility -= (_makespan[k] - instance->window_end[b]);
   }
-  if (_makespan[k+1] > window_end[c]) {
+  if (_makespan[k+1] > instance->window_end[c]) {
     _constraint_violations--;
-    _infeasibility -= (_makespan[k+1] - window_end[c]);
+    _infeasibility -= (_makespan[k+1] - instance->window_end[c]);
   }
 
-  _makespan[k] = max (_makespan[k-1] + distance[a][c], window_start[c]);
-  _makespan[k+1] = max (_makespan[k] + distance[c][b], window_start[b]);
+  _makespan[k] = max (_makespan[k-1] + instance->distance[a][c], instance->window_start[c]);
+  _makespan[k+1] = max (_makespan[k] + instance->distance[c][b], instance->window_start[b]);
 
-  if (_makespan[k] > window_end[c]) {
+  if (_makespan[k] > instance->window_end[c]) {
     _constraint_violations++;
-    _infeasibility += (_makespan[k] - window_end[c]);
+    _infeasibility += (_makespan[k] - instance->window_end[c]);
   }
-  if (_makespan[k+1] > window_end[b]) {
+  if (_makespan[k+1] > instance->window_end[b]) {
     _constraint_violations++;
-    _infeasibility += (_makespan[k+1] - window_end[b]);
+    _infeasibility += (_makespan[k+1] - instance->window_end[b]);
   }
 
   auto mkspan = _makespan[k+1];
   int i, current, prev = b; // permutation[k+1]
-  for (i = k + 2; i < n + 1; i++, prev = current) {
+  for (i = k + 2; i < instance->n + 1; i++, prev = current) {
     current = permutation[i];
     
     /* There are some problems with rounding and check_solution()
        complains. Use 'volatile' to avoid optimizations here. This
        unfortunately may produce slower results.  */
-    mkspan += distance[prev][current];
+    mkspan += instance->distance[prev][current];
 
-    if (_makespan[i] > window_start[current]) {
+    if (_makespan[i] > instance->window_start[current]) {
         // We did not have to wait ...
-        if (_makespan[i] > window_end[current]) {
+        if (_makespan[i] > instance->window_end[current]) {
             // ... we broke a constraint before.
             _constraint_violations--;
-            _infeasibility -= (_makespan[i] - window_end[current]);
+            _infeasibility -= (_makespan[i] - instance->window_end[current]);
         }
-        if (mkspan <= window_start[current]) {
+        if (mkspan <= instance->window_start[current]) {
             // ... we now have to wait so everything changes.
-            _makespan[i] = window_start[current];
-            mkspan = window_start[current];
+            _makespan[i] = instance->window_start[current];
+            mkspan = instance->window_start[current];
             continue;
         }
     } else {//(_makespan[i] <= window_start[current])
         // We had to wait before ...
-        if (mkspan <= window_start[current]) {
+        if (mkspan <= instance->window_start[current]) {
             // ... we still have to wait and everything else stays the same.
-            _makespan[i] = window_start[current];
+            _makespan[i] = instance->window_start[current];
             break;
         }
     }
-    if (mkspan > window_end[current]) {
+    if (mkspan > instance->window_end[current]) {
         // ... we do not wait but we break a constraint.
         _constraint_violations++;
-        _infeasibility += (mkspan - window_end[current]);
+        _infeasibility += (mkspan - instance->window_end[current]);
     }
     _makespan[i] = mkspan;
   }
-  evaluations += i - (k + 2);
+  *evaluations += i - (k + 2);
 
 #if DEBUG > 2
   fprintf (stderr, "makespan[%d]: ", _makespan.size());
-  for (int i = 0; i < n+1; i++)
+  for (int i = 0; i < instance->n+1; i++)
     fprintf (stderr, " %g", (double)_makespan[i]);
   fprintf (stderr, "\n\n");
 #endif
 }
 
 Solution *
-Solution::RandomSolution (Random *rng)
+Solution::RandomSolution (const Instance *instance,
+                          atomic<unsigned int> *evaluations, Random *rng)
 {
-  Solution s;
-  int * r = rng->generate_array (n-1);
-  for (int k = 0; k < n - 1; k++)
+  Solution s (instance, evaluations);
+  int * r = rng->generate_array (instance->n-1);
+  for (int k = 0; k < instance->n - 1; k++)
     r[k]++;
   s.add (r);
   DEBUG1 (s.assert_solution());
@@ -913,7 +955,7 @@ Solution::infeasible_move (int initial, int final) const
      infeasible moves for infeasible solutions
      (!_constraint_violations && ...) provides a more thorough
      search, however, it is far slower.  */
-    return tw_infeasible[permutation[final]][permutation[initial]];
+    return instance->tw_infeasible[permutation[final]][permutation[initial]];
 }
 
 
@@ -922,12 +964,16 @@ Solution::infeasible_move (int initial, int final) const
 Solution *
 Solution::localsearch_insertion (const bool first_improvement_p)
 {
+#ifdef MINIMISE_TOURCOST
+  if (_constraint_violations == 0)
+    return localsearch_insertion_feasible (first_improvement_p);
+#endif
   Solution best = *this;
-  Solution sol;
+  Solution sol (instance, evaluations);
   /* for i=1 to n-1, we incrementally search all of the transitions
      that examine I(i,d) insertions of customer i, d positions later
      in the tour.  */
-  for (int i = 1; i < n - 1; i++) {
+  for (int i = 1; i < instance->n - 1; i++) {
     DEBUG2 (fprintf (stderr, "%2d:%2d: ", 0, 0); sol.print_one_line (stderr));
     bool move_p = this->infeasible_move (i, i+1);
     if (move_p) {
@@ -957,7 +1003,7 @@ Solution::localsearch_insertion (const bool first_improvement_p)
     }
     
     Solution orb1 = sol;
-    for (int d = i + 1; d < n - 1; d++) {
+    for (int d = i + 1; d < instance->n - 1; d++) {
       move_p = sol.infeasible_move (d, d + 1);
       if (move_p) {
 #if DEBUG >= 2
@@ -1027,6 +1073,271 @@ Solution::localsearch_insertion (const bool first_improvement_p)
   return best.clone();
 }
 
+/* The same search as localsearch_insertion() for a feasible tour when
+   minimising the tour cost. Only feasible moves can improve it, so
+   each move is evaluated by its change in tour cost without doing it,
+   and only the moves that improve the cost are checked for
+   feasibility with the forward time slack. Moves are examined in the
+   same order, so the result is the same.  */
+Solution *
+Solution::localsearch_insertion_feasible (const bool first_improvement_p)
+{
+  const int n = instance->n;
+  const Matrix<number_t> &distance = instance->distance;
+  static thread_local vector<number_t> slack;
+  forward_slack (slack);
+
+  number_t best_cost = _tourcost;
+  int best_from = 0, best_to = 0;
+  unsigned int count = 0;
+
+  for (int i = 1; i < n - 1; i++) {
+    if (this->infeasible_move (i, i+1)) continue;
+
+    /* The customer at i goes j positions later, j >= 1, until it
+       would follow a customer that must be served after it.  */
+    int ci = permutation[i];
+    number_t removed = distance[permutation[i-1]][ci]
+      + distance[ci][permutation[i+1]]
+      - distance[permutation[i-1]][permutation[i+1]];
+    for (int j = i + 1; j < n; j++) {
+      int cj = permutation[j];
+      if (instance->tw_infeasible[cj][ci]) break;
+      number_t cost = _tourcost - removed + distance[cj][ci]
+        + distance[ci][permutation[j+1]] - distance[cj][permutation[j+1]];
+      if (fless (cost, best_cost)
+          && insertion_is_feasible (i, j, slack, count)) {
+        best_cost = cost;
+        best_from = i;
+        best_to = j;
+        if (first_improvement_p) goto done;
+      }
+    }
+
+    /* The customer at i + 1 goes two or more positions earlier, until
+       it would precede a customer that must be served before it.  */
+    ci = permutation[i+1];
+    removed = distance[permutation[i]][ci]
+      + distance[ci][permutation[i+2]]
+      - distance[permutation[i]][permutation[i+2]];
+    for (int j = i - 1; j > 0; j--) {
+      int cj = permutation[j];
+      if (instance->tw_infeasible[ci][cj]) break;
+      number_t cost = _tourcost - removed + distance[permutation[j-1]][ci]
+        + distance[ci][cj] - distance[permutation[j-1]][cj];
+      if (fless (cost, best_cost)
+          && insertion_is_feasible (i + 1, j, slack, count)) {
+        best_cost = cost;
+        best_from = i + 1;
+        best_to = j;
+        if (first_improvement_p) goto done;
+      }
+    }
+  }
+
+ done:
+  *evaluations += count;
+  Solution *s = clone();
+  if (best_from != best_to) {
+    reinsert (s->permutation, best_from, best_to);
+    s->reschedule (min (best_from, best_to), max (best_from, best_to), 0, 0);
+    s->_tourcost = best_cost;
+    DEBUG1 (s->assert_solution());
+  }
+  return s;
+}
+
+
+/* Or-opt moves take the len customers starting at position i and place
+   them, without reversing them, right after the customer now at
+   position j. Since no part of the tour is reversed, they are valid
+   for asymmetric instances.
+
+   I. Or, "Traveling salesman-type combinatorial problems and their
+   relation to the logistics of regional blood banking", PhD thesis,
+   Northwestern University, 1976.  */
+
+/* Customer at position p after the move (i, len, j), for p between the
+   first and the last position whose customer changes.  */
+inline int
+Solution::oropt_customer (int i, int len, int j, int p) const
+{
+  if (j > i) { // Forward: the customers in (i + len - 1, j] go first.
+    int m = j - (i + len) + 1;
+    return (p < i + m) ? permutation[p + len] : permutation[p - m];
+  } else { // Backward: the segment goes first.
+    int m = i - (j + 1);
+    return (p <= j + len) ? permutation[p + m] : permutation[p - len];
+  }
+}
+
+/* Compute the constraint violations, infeasibility and makespan after
+   the move (i, len, j) without doing it. Start times are recomputed
+   from the first position that changes until they agree with the
+   current ones. If this solution is feasible, return false as soon as
+   the move breaks a time window.  */
+bool
+Solution::oropt_evaluate (int i, int len, int j, int &cviols,
+                          number_t &infeas, number_t &mkspan_end) const
+{
+  int low = (j > i) ? i : j + 1;
+  int high = (j > i) ? j : i + len - 1;
+  number_t mkspan = _makespan[low - 1];
+  int prev = permutation[low - 1];
+  int p;
+
+  cviols = _constraint_violations;
+  infeas = _infeasibility;
+  for (p = low; p < instance->n + 1; p++) {
+    int c = (p <= high) ? oropt_customer (i, len, j, p) : permutation[p];
+    mkspan = max (mkspan + instance->distance[prev][c], instance->window_start[c]);
+    // The rest of the tour stays the same.
+    if (p > high and mkspan == _makespan[p]) break;
+
+    int old_c = permutation[p];
+    if (_makespan[p] > instance->window_end[old_c]) {
+      cviols--;
+      infeas -= _makespan[p] - instance->window_end[old_c];
+    }
+    if (mkspan > instance->window_end[c]) {
+      if (_constraint_violations == 0) {
+        *evaluations += p - low + 1;
+        return false;
+      }
+      cviols++;
+      infeas += mkspan - instance->window_end[c];
+    }
+    prev = c;
+  }
+  *evaluations += p - low;
+  mkspan_end = (p == instance->n + 1) ? mkspan : _makespan[instance->n];
+  return true;
+}
+
+/* Do the move (i, len, j), given its effect computed by
+   oropt_evaluate().  */
+void
+Solution::oropt_move (int i, int len, int j, number_t delta_cost,
+                      int cviols, number_t infeas)
+{
+  int low, high;
+  if (j > i) {
+    low = i;
+    high = j;
+    std::rotate (permutation.begin() + i, permutation.begin() + i + len,
+                 permutation.begin() + j + 1);
+  } else {
+    low = j + 1;
+    high = i + len - 1;
+    std::rotate (permutation.begin() + j + 1, permutation.begin() + i,
+                 permutation.begin() + i + len);
+  }
+  _tourcost += delta_cost;
+  _constraint_violations = cviols;
+  _infeasibility = infeas;
+
+  number_t mkspan = _makespan[low - 1];
+  for (int p = low; p < instance->n + 1; p++) {
+    mkspan = max (mkspan + instance->distance[permutation[p - 1]][permutation[p]],
+                  instance->window_start[permutation[p]]);
+    if (p > high and mkspan == _makespan[p]) break;
+    _makespan[p] = mkspan;
+  }
+  DEBUG1 (assert_solution());
+}
+
+/* Do the move (i, len, j) if it gives a better solution.  */
+bool
+Solution::oropt_improves (int i, int len, int j, number_t delta_cost)
+{
+  int cviols;
+  number_t infeas, mkspan_end;
+
+#if defined(MINIMISE_TOURCOST)
+  // A feasible solution only improves if the tour cost does.
+  if (_constraint_violations == 0 and delta_cost >= 0)
+    return false;
+#endif
+  if (!oropt_evaluate (i, len, j, cviols, infeas, mkspan_end))
+    return false;
+
+#if defined(MINIMISE_TOURCOST)
+  number_t new_cost = _tourcost + delta_cost;
+#elif defined(MINIMISE_MAKESPAN)
+  number_t new_cost = mkspan_end;
+#endif
+  if (cviols < _constraint_violations
+      || (cviols == _constraint_violations && fless (new_cost, cost()))) {
+    DEBUG2 (fprintf (stderr, "# oropt (%d, %d, %d): ", i, len, j));
+    oropt_move (i, len, j, delta_cost, cviols, infeas);
+    DEBUG2 (print_one_line (stderr));
+    return true;
+  }
+  return false;
+}
+
+/* One pass over all Or-opt moves of segments of one to three
+   customers, doing every improving move as soon as it is found.  As in
+   the insertion local search, a segment is not moved past a customer
+   that cannot be directly before (or after) it.  */
+bool
+Solution::oropt_first (void)
+{
+  bool improved = false;
+
+  for (int len = 1; len <= 3; len++) {
+    for (int i = 1; i + len <= instance->n; i++) {
+      int prev = permutation[i - 1];
+      int first = permutation[i];
+      int last = permutation[i + len - 1];
+      int next = permutation[i + len];
+      number_t delta_remove = instance->distance[prev][next]
+        - instance->distance[prev][first] - instance->distance[last][next];
+
+      // Forward, after the customer at j.
+      for (int j = i + len; j < instance->n; j++) {
+        int cj = permutation[j];
+        if (instance->tw_infeasible[cj][first]) break;
+        int sj = permutation[j + 1];
+        number_t delta = delta_remove + instance->distance[cj][first]
+          + instance->distance[last][sj] - instance->distance[cj][sj];
+        if (oropt_improves (i, len, j, delta)) {
+          improved = true;
+          break;
+        }
+      }
+      // The segment may have moved.
+      first = permutation[i];
+      last = permutation[i + len - 1];
+      prev = permutation[i - 1];
+      next = permutation[i + len];
+      delta_remove = instance->distance[prev][next]
+        - instance->distance[prev][first] - instance->distance[last][next];
+
+      // Backward, after the customer at j.
+      for (int j = i - 2; j >= 0; j--) {
+        int cj = permutation[j];
+        int sj = permutation[j + 1];
+        if (instance->tw_infeasible[last][sj]) break;
+        number_t delta = delta_remove + instance->distance[cj][first]
+          + instance->distance[last][sj] - instance->distance[cj][sj];
+        if (oropt_improves (i, len, j, delta)) {
+          improved = true;
+          break;
+        }
+      }
+    }
+  }
+  return improved;
+}
+
+Solution *
+Solution::localsearch_oropt (void)
+{
+  Solution * s = this->clone();
+  s->oropt_first();
+  return s;
+}
 
 number_t Solution::delta_swap(int k)
 {
@@ -1037,10 +1348,10 @@ number_t Solution::delta_swap(int k)
     int c = p[k+1];
     int d = p[k+2];
 
-    number_t delta = (distance[a][c] + distance[c][b] + distance[b][d])
-        - (distance[a][b] + distance[b][c] + distance[c][d]);
+    number_t delta = (instance->distance[a][c] + instance->distance[c][b] + instance->distance[b][d])
+        - (instance->distance[a][b] + instance->distance[b][c] + instance->distance[c][d]);
 
-    evaluations += 6;
+    *evaluations += 6;
     DEBUG3(fprintf (stderr, "a = %2d, b = %2d, c = %2d, d = %2d  ", a, b, c, d);
            fprintf (stderr, "cost + delta = %g + %g = %g \t",
                     (double)_tourcost, (double)delta, (double)_tourcost + delta));
@@ -1059,11 +1370,11 @@ bool Solution::is_feasible_swap(int k, int &first_m)
     // Otherwise, we have to update all.
     DEBUG1 (assert(check_partial_solution(min(first_m, k))));
 
-    int last_m = (first_m == n + 1) ? k + 2 : n + 1;
+    int last_m = (first_m == instance->n + 1) ? k + 2 : instance->n + 1;
     int j, prev, current;
     for (j = min (first_m, k); j < last_m; j++) {
-        _makespan[j] = max (_makespan[j-1] + distance[p[j-1]][p[j]], window_start[p[j]]);
-        if (_makespan[j] > window_end[p[j]]) {
+        _makespan[j] = max (_makespan[j-1] + instance->distance[p[j-1]][p[j]], instance->window_start[p[j]]);
+        if (_makespan[j] > instance->window_end[p[j]]) {
             first_m = j;
             DEBUG1 (assert(check_partial_solution(first_m)));
             DEBUG_PRINT_MAKESPAN();
@@ -1073,30 +1384,30 @@ bool Solution::is_feasible_swap(int k, int &first_m)
 
     prev = p[last_m - 1];
     number_t mkspan = _makespan[last_m - 1];
-    for (j = last_m; j < n + 1; j++, prev = current) {
+    for (j = last_m; j < instance->n + 1; j++, prev = current) {
         current = p[j];
-        mkspan += distance[prev][current];
+        mkspan += instance->distance[prev][current];
         // We had to wait before ...
-        if (_makespan[j] <= window_start[current]) {
-            if (mkspan <= window_start[current]) {
+        if (_makespan[j] <= instance->window_start[current]) {
+            if (mkspan <= instance->window_start[current]) {
                 // ... we still have to wait and everything else stays the same.
-                _makespan[j] = window_start[current];
-                first_m = n + 1;
+                _makespan[j] = instance->window_start[current];
+                first_m = instance->n + 1;
                 DEBUG_PRINT_MAKESPAN();
                 return true;
             }
         } else {
             // We did not have to wait ...
-            assert (_makespan[j] <= window_end[current]);
+            assert (_makespan[j] <= instance->window_end[current]);
             // ... we did NOT break a constraint before.
-            if (mkspan <= window_start[current]) {
+            if (mkspan <= instance->window_start[current]) {
                 // ... we now have to wait so everything changes.
-                _makespan[j] = window_start[current];
-                mkspan = window_start[current];
+                _makespan[j] = instance->window_start[current];
+                mkspan = instance->window_start[current];
                 continue;
             }
         }
-        if (mkspan > window_end[current]) {
+        if (mkspan > instance->window_end[current]) {
             // ... we do not wait but we break a constraint.
             _makespan[j] = mkspan;
             first_m = j;
@@ -1106,7 +1417,7 @@ bool Solution::is_feasible_swap(int k, int &first_m)
         }
         _makespan[j] = mkspan;
     }
-    first_m = n + 1;
+    first_m = instance->n + 1;
     DEBUG_PRINT_MAKESPAN();
     return true;
 }
@@ -1146,98 +1457,79 @@ Solution::shuffle_1shift_feasible_nodes(vector<int> &v, Random &rng)
 {
     v.clear();
 
-    for (int i = 1; i < n - 1; i++) {
+    for (int i = 1; i < instance->n - 1; i++) {
         int ci = permutation[i];
         int cj = permutation[i+1];
-        if (tw_infeasible[cj][ci]) continue;
+        if (instance->tw_infeasible[cj][ci]) continue;
         v.push_back(i);
     }    
     std::random_shuffle(v.begin(), v.end(), rng);
 }
 
+/* Store in slack[i] the forward time slack of position i of a feasible
+   tour, that is, the largest delay of the start of service at position
+   i that keeps the rest of the tour feasible:
+
+   slack[i] = min (window_end[i] - start[i], wait[i+1] + slack[i+1])
+
+   M.W.P. Savelsbergh, "The vehicle routing problem with time windows:
+   Minimizing route duration", ORSA Journal on Computing, vol. 4,
+   pp. 146--154, 1992.  */
+void
+Solution::forward_slack(vector<number_t> &slack) const
+{
+    assert (_constraint_violations == 0);
+    slack.resize(instance->n + 1);
+    slack[instance->n] = instance->window_end[permutation[instance->n]] - _makespan[instance->n];
+    for (int i = instance->n - 1; i >= 0; i--) {
+        int ci = permutation[i];
+        int cj = permutation[i + 1];
+        number_t wait = _makespan[i + 1] - (_makespan[i] + instance->distance[ci][cj]);
+        slack[i] = min (instance->window_end[ci] - _makespan[i], wait + slack[i + 1]);
+    }
+}
+
+/* Is this feasible tour still feasible after moving the customer at
+   position from to position to? Only the customers between both
+   positions are visited; the rest of the tour is checked with the
+   forward slack (see forward_slack()). Return the number of customers
+   visited in count.  */
 bool
-Solution::insertion_is_feasible(int from, int to)
+Solution::insertion_is_feasible(int from, int to,
+                                const vector<number_t> &slack,
+                                unsigned int &count) const
 {
-    /* FIXME: Only copy the relevant makespan */
-    vector<number_t> makespan = this->_makespan;
     int low = min(from, to);
     int high = max(from, to);
     number_t mkspan = this->_makespan[low - 1];
     int pred_ci = permutation[low - 1];
     int i, ci;
-    if (from < to) {
-        ci = permutation[low + 1];
-        mkspan += distance[pred_ci][ci];
-        if (mkspan < window_start[ci]) {
-            mkspan = window_start[ci];
-        } else if (mkspan > window_end[ci]){
-            return false;
-        }
-        makespan[low] = mkspan;
-        for (i = low + 2, pred_ci = ci;
-             i <= high; 
-             i++, pred_ci = ci) {
-            ci = permutation[i];
-            mkspan += distance[pred_ci][ci];
-            if (mkspan < window_start[ci]) {
-                mkspan = window_start[ci];
-            } else if (mkspan > window_end[ci]) {
-                return false;
-            }
-            makespan[i - 1] = mkspan;
-        }
-        pred_ci = permutation[high];
-        ci = permutation[from];
-        mkspan += distance[pred_ci][ci];
-        if (mkspan < window_start[ci]) {
-            mkspan = window_start[ci];
-        } else if (mkspan > window_end[ci]) {
-            return false;
+
+    for (i = low; i <= high; i++, pred_ci = ci) {
+        if (from < to) {
+            ci = (i < high) ? permutation[i + 1] : permutation[from];
+        } else {
+            ci = (i > low) ? permutation[i - 1] : permutation[from];
         }
-        makespan[high] = mkspan;
-        pred_ci = permutation[low];
-
-    } else /* from > to */{
-        ci = permutation[from];
-        mkspan += distance[pred_ci][ci];
-        if (mkspan < window_start[ci]) {
-            mkspan = window_start[ci];
-        } else if (mkspan > window_end[ci]) {
-            /* ??? In theory, if it was feasible before, so by the triangle inequality, it
-               has to be feasible now, but this doesn't work for some reason.  */
-            /* assert(mkspan <= window_end[ci]); */
+        mkspan += instance->distance[pred_ci][ci];
+        if (mkspan < instance->window_start[ci]) {
+            mkspan = instance->window_start[ci];
+        } else if (mkspan > instance->window_end[ci]) {
+            count += i - low + 1;
             return false;
         }
-        makespan[low] = mkspan;
-        for (i = low, pred_ci = ci;
-             i < high; 
-             i++, pred_ci = ci) {
-            ci = permutation[i];
-            mkspan += distance[pred_ci][ci];
-            if (mkspan < window_start[ci]) {
-                mkspan = window_start[ci];
-            } else if (mkspan > window_end[ci]) {
-                return false;
-            }
-            makespan[i + 1] = mkspan;
-        }
-        pred_ci = permutation[high - 1];
     }
-    for (i = high + 1;
-         i < n + 1;
-         i++, pred_ci = ci) {
-        ci = permutation[i];
-        mkspan += distance[pred_ci][ci];
-        if (mkspan < window_start[ci]) {
-            mkspan = window_start[ci];
-        } else if (mkspan > window_end[ci]) {
+    count += high - low + 1;
+
+    // The rest of the tour starts later by delay, if positive.
+    if (high < instance->n) {
+        ci = permutation[high + 1];
+        number_t start = max (mkspan + instance->distance[pred_ci][ci],
+                              instance->window_start[ci]);
+        number_t delay = start - this->_makespan[high + 1];
+        if (delay > 0 && delay > slack[high + 1])
             return false;
-        }
-        makespan[i] = mkspan;
     }
-    // copy range affected from temp makespan to current solution.
-    std::copy(makespan.begin() + low, makespan.end(), 
-              this->_makespan.begin() + low);
     return true;
 }
 
@@ -1245,48 +1537,55 @@ bool
 Solution::feasible_1shift_first(Random &rng)
 {
     assert (_constraint_violations == 0);
-    Solution ngh;
-    Solution saved_ngh;
+    Solution ngh (instance, evaluations);
+    Solution saved_ngh (instance, evaluations);
 
     DEBUG2(fprintf(stderr, "# 1shift_feasible: START: ");
            this->print_one_line (stderr));
 
     vector<int> rand_nodes;
     shuffle_1shift_feasible_nodes(rand_nodes, rng);
+    static thread_local vector<number_t> slack;
+    forward_slack(slack);
+    unsigned int count = 0;
 
     for (int k = 0; k < int(rand_nodes.size()); k++) {
         int i = rand_nodes[k];
         int ci = permutation[i];
-        number_t delta1 = distance[permutation[i-1]][ci] 
-            + distance[ci][permutation[i+1]]
-            - distance[permutation[i-1]][permutation[i+1]];
+        number_t delta1 = instance->distance[permutation[i-1]][ci] 
+            + instance->distance[ci][permutation[i+1]]
+            - instance->distance[permutation[i-1]][permutation[i+1]];
         // This is in fact swapping backwards i + 1
         for (int d = i - 1; d > 0; d--) {
             int cj = permutation[d];
-            if (tw_infeasible[ci][cj]) break;
-            number_t delta2 = distance[permutation[d-1]][ci]
-                + distance[ci][cj] - distance[permutation[d-1]][cj];
+            if (instance->tw_infeasible[ci][cj]) break;
+            number_t delta2 = instance->distance[permutation[d-1]][ci]
+                + instance->distance[ci][cj] - instance->distance[permutation[d-1]][cj];
             
             if (delta2 >= delta1) continue;
-            if (!insertion_is_feasible(i, d)) continue;
+            if (!insertion_is_feasible(i, d, slack, count)) continue;
+            *evaluations += count;
             reinsert(permutation, i, d);
+            reschedule(min(i, d), max(i, d), 0, 0);
             DEBUG2_FUNPRINT ("improved (%d, %d): %g -> %g\n", i, i+1, 
                              double(this->_tourcost),
                              double(this->_tourcost - delta1 + delta2));
-            this->_tourcost +=  delta2 - delta1;
+            this->_tourcost += delta2 - delta1;
             DEBUG1 (assert_solution());
             return true;
         }
         // This is in fact swapping forward i
-        for (int d = i + 2; d < n; d++) {
+        for (int d = i + 2; d < instance->n; d++) {
             int cj = permutation[d];
-            if (tw_infeasible[cj][ci]) break;
-            number_t delta2 = distance[ci][permutation[d+1]]
-                + distance[cj][ci] - distance[cj][permutation[d+1]];
+            if (instance->tw_infeasible[cj][ci]) break;
+            number_t delta2 = instance->distance[ci][permutation[d+1]]
+                + instance->distance[cj][ci] - instance->distance[cj][permutation[d+1]];
             
             if (delta2 >= delta1) continue;
-            if (!insertion_is_feasible(i, d)) continue;
+            if (!insertion_is_feasible(i, d, slack, count)) continue;
+            *evaluations += count;
             reinsert(permutation, i, d);
+            reschedule(min(i, d), max(i, d), 0, 0);
             DEBUG2_FUNPRINT ("improved (%d, %d): %g -> %g\n", i, i+1, 
                              double(this->_tourcost),
                              double(this->_tourcost - delta1 + delta2));
@@ -1295,6 +1594,7 @@ Solution::feasible_1shift_first(Random &rng)
             return true;
         }
     }
+    *evaluations += count;
     DEBUG2(fprintf(stderr, "# 1shift_feasible: END: ");
            this->print_one_line (stderr));
     return false;
@@ -1307,25 +1607,25 @@ bool
 Solution::feasible_1shift_first()
 {
     assert (_constraint_violations == 0);
-    Solution ngh;
-    Solution back_ngh;
+    Solution ngh (instance, evaluations);
+    Solution back_ngh (instance, evaluations);
     bool improved = false;
 
     DEBUG2(fprintf(stderr, "# 1shift_feasible: START: ");
            this->print_one_line (stderr));
 
-    for (int i = 1; i < n - 1; i++) {
+    for (int i = 1; i < instance->n - 1; i++) {
         int ci = permutation[i];
         int cj = permutation[i+1];
-        if (tw_infeasible[cj][ci]) continue;
+        if (instance->tw_infeasible[cj][ci]) continue;
         ngh = *this;
-        int first_m = n + 1;
+        int first_m = instance->n + 1;
         number_t delta_cost = 0;
         DEBUG2 (fprintf (stderr, "# insertion: %2d:%2d:%2d: ", i, i, i+1));
         if (ngh.do_feasible_swap(i, delta_cost, first_m)) {
             assert(delta_cost < 0);
             assert(this->_tourcost + delta_cost == ngh._tourcost);
-            assert(first_m == n + 1);
+            assert(first_m == instance->n + 1);
             DEBUG2_FUNPRINT ("improved (%d, %d): %g -> %g\n", i, i+1, 
                              double(this->_tourcost), double(ngh._tourcost));
             *this = ngh;
@@ -1340,15 +1640,15 @@ Solution::feasible_1shift_first()
         number_t back_delta_cost = delta_cost;
         // std::copy(permutation.begin(), permutation.end(), p);
         // std::copy(_makespan.begin(), _makespan.end(), makespan);
-        for (int d = i + 1; d < n - 1; d++) {
+        for (int d = i + 1; d < instance->n - 1; d++) {
             ci = ngh.permutation[d];
             cj = ngh.permutation[d+1];
-            if (tw_infeasible[cj][ci]) break;
+            if (instance->tw_infeasible[cj][ci]) break;
             DEBUG2 (fprintf (stderr, "# insertion: %2d:%2d:%2d: ", d, i, d+1));
             if (ngh.do_feasible_swap(d, delta_cost, first_m)) {
                 assert(delta_cost < 0);
                 assert(this->_tourcost + delta_cost == ngh._tourcost);
-                assert(first_m == n + 1);
+                assert(first_m == instance->n + 1);
                 DEBUG2_FUNPRINT ("improved (%d, %d): %g -> %g\n", i, d, 
                                  double(this->_tourcost), double(ngh._tourcost));
                 *this = ngh;
@@ -1364,12 +1664,12 @@ Solution::feasible_1shift_first()
         for (int d = i - 1; d > 0; d--) {
             ci = back_ngh.permutation[d];
             cj = back_ngh.permutation[d+1];
-            if (tw_infeasible[cj][ci]) break;
+            if (instance->tw_infeasible[cj][ci]) break;
             DEBUG2 (fprintf (stderr, "# insertion: %2d:%2d:%2d: ", d, i+1, d));
             if (back_ngh.do_feasible_swap(d, delta_cost, back_first_m)) {
                 assert(delta_cost < 0);
                 assert(this->_tourcost + delta_cost == back_ngh._tourcost);
-                assert(back_first_m == n + 1);
+                assert(back_first_m == instance->n + 1);
                 DEBUG2_FUNPRINT ("improved (%d, %d): %g -> %g\n", i+1, d, 
                                  double(this->_tourcost), double(back_ngh._tourcost));
                 *this = back_ngh;
@@ -1406,8 +1706,8 @@ Solution::compute_feas_set(vector<int> &feas, Random &rng)
 {
     feas.clear();
 
-    for (int i = 1; i < n; i++) {
-        if (_makespan[i] <= window_end[i]) feas.push_back(i);
+    for (int i = 1; i < instance->n; i++) {
+        if (_makespan[i] <= instance->window_end[i]) feas.push_back(i);
     }
     std::random_shuffle(feas.begin(), feas.end(), rng);
 }
@@ -1417,8 +1717,8 @@ Solution::compute_infeas_set(vector<int> &infeas, Random &rng)
 {
     infeas.clear();
 
-    for (int i = 1; i < n; i++) {
-        if (_makespan[i] > window_end[i]) infeas.push_back(i);
+    for (int i = 1; i < instance->n; i++) {
+        if (_makespan[i] > instance->window_end[i]) infeas.push_back(i);
     }
     std::random_shuffle(infeas.begin(), infeas.end(), rng);
 }
@@ -1427,15 +1727,15 @@ bool
 Solution::backward_violated(bool &improved, Random &rng)
 {
     vector<int> infeas;
-    infeas.reserve(n - 1);
+    infeas.reserve(instance->n - 1);
     compute_infeas_set(infeas, rng);
     
-    Solution sol;
+    Solution sol (instance, evaluations);
     // Backward movements of violated customers.
     do {
         int  i = infeas.back();
         infeas.pop_back();
-        assert (_makespan[i] > window_end[i]);
+        assert (_makespan[i] > instance->window_end[i]);
         sol = *this;
         bool moved = false;
         for (int d = i - 1; d > 0; d--) {
@@ -1465,15 +1765,15 @@ Solution::forward_nonviolated(bool &improved, Random &rng)
     vector<int> feas;
     compute_feas_set(feas, rng);
     
-    Solution sol;
+    Solution sol (instance, evaluations);
     // Forward movements of non-violated customers.
     do {
         int i = feas.back();
         feas.pop_back();
-        assert (_makespan[i] <= window_end[i]);
+        assert (_makespan[i] <= instance->window_end[i]);
         sol = *this;
         bool moved = false;
-        for (int d = i; d < n - 1; d++) {
+        for (int d = i; d < instance->n - 1; d++) {
             if (sol.infeasible_move (d, d + 1)) break;
             sol.swap(d);
             if (sol.infeasibility() < this->infeasibility()) {
@@ -1499,15 +1799,15 @@ Solution::forward_violated(bool &improved, Random &rng)
     vector<int> infeas;
     compute_infeas_set(infeas, rng);
     
-    Solution sol;
+    Solution sol (instance, evaluations);
     // Forward movements of violated customers.
     do {
         int i = infeas.back();
         infeas.pop_back();
-        assert (_makespan[i] > window_end[i]);
+        assert (_makespan[i] > instance->window_end[i]);
         sol = *this;
         bool moved = false;
-        for (int d = i; d < n - 1; d++) {
+        for (int d = i; d < instance->n - 1; d++) {
             if (sol.infeasible_move (d, d + 1)) break;
             sol.swap(d);
             if (sol.infeasibility() < this->infeasibility()) {
@@ -1534,13 +1834,13 @@ Solution::backward_nonviolated(bool &improved, Random &rng)
     vector<int> feas;
     compute_feas_set(feas, rng);
     
-    Solution sol;
+    Solution sol (instance, evaluations);
 
     // Backward movements of non-violated customers.
     do {
         int i = feas.back();
         feas.pop_back();
-        assert (_makespan[i] <= window_end[i]);
+        assert (_makespan[i] <= instance->window_end[i]);
         sol = *this;
         bool moved = false;
         for (int d = i - 1; d > 0; d--) {
@@ -1614,8 +1914,8 @@ Solution::feasibility_1shift_first()
 
     Solution sol = *this;
     // Backward movements of violated customers.
-    for (int i = 2; i < n; i++) {
-        if (_makespan[i] <= window_end[i]) continue;
+    for (int i = 2; i < instance->n; i++) {
+        if (_makespan[i] <= instance->window_end[i]) continue;
         sol = *this;
         for (int d = i - 1; d > 0; d--) {
             if (sol.infeasible_move(d, d + 1)) break;
@@ -1631,8 +1931,8 @@ Solution::feasibility_1shift_first()
         }
     }
 
-    for (int i = 1; i < n - 1; i++) {
-        if (_makespan[i] > window_end[i]) continue;
+    for (int i = 1; i < instance->n - 1; i++) {
+        if (_makespan[i] > instance->window_end[i]) continue;
         if (infeasible_move (i, i+1)) continue;
         sol = *this;
         // Forward movements of non-violated customers.
@@ -1647,7 +1947,7 @@ Solution::feasibility_1shift_first()
         }
         Solution back_sol = sol;
 
-        for (int d = i + 1; d < n - 1; d++) {
+        for (int d = i + 1; d < instance->n - 1; d++) {
             if (sol.infeasible_move (d, d + 1)) break;
             sol.swap(d);
             if (sol.infeasibility() < this->infeasibility()) {
@@ -1676,10 +1976,10 @@ Solution::feasibility_1shift_first()
     }
 
     // Forward movements of violated customers.
-    for (int i = 1; i < n - 1; i++) {
-        if (_makespan[i] <= window_end[i]) continue;
+    for (int i = 1; i < instance->n - 1; i++) {
+        if (_makespan[i] <= instance->window_end[i]) continue;
         sol = *this;
-        for (int d = i; d < n - 1; d++) {
+        for (int d = i; d < instance->n - 1; d++) {
             if (sol.infeasible_move (d, d + 1)) break;
             sol.swap(d);
             if (sol.infeasibility() < this->infeasibility()) {
@@ -1701,73 +2001,77 @@ Solution::feasibility_1shift_first()
 /* The tour to check is:
 
    [H1] -> [H3] -> B -> ... A -> [H1 + 1] -> [H3 + 1]
+
+   Return 0 if it is feasible, and then update _makespan as if the move
+   had been done. The new start times are computed in a buffer reused
+   across calls, from position h1 + 1 up to the last one that
+   changes.
 */
 int
 Solution::two_opt_is_infeasible(int h1, int h3)
 {
-    /* FIXME: Only copy the relevant makespan */
-    vector<number_t> makespan = this->_makespan;
-    int mkspan = this->_makespan[h1];
+    static thread_local vector<number_t> segment;
+    number_t mkspan = this->_makespan[h1];
     // Check feasibility of the new edge
     int pred_ci = permutation[h1];
     int ci = permutation[h3];
-    mkspan += distance[pred_ci][ci];
-    if (mkspan < window_start[ci]) {
-        mkspan = window_start[ci];
-    } else if (mkspan > window_end[ci]) {
+    mkspan += instance->distance[pred_ci][ci];
+    if (mkspan < instance->window_start[ci]) {
+        mkspan = instance->window_start[ci];
+    } else if (mkspan > instance->window_end[ci]) {
         return 1;
     }
-    makespan[h1 + 1] = mkspan;
+    if (segment.size() < size_t(instance->n + 1))
+        segment.resize(instance->n + 1);
+    // makespan[k] is the new start time of position h1 + 1 + k.
+    number_t *makespan = &segment[0];
+    int k = 0;
+    makespan[k++] = mkspan;
     int i = h3 - 1;
-    int j = h1 + 2;
     pred_ci = permutation[h3];
     // Check feasibility of the reversed part.
-    // i moves back in the reversed part, j moves forward in makespan.
+    // i moves back in the reversed part.
     while (i >= h1 + 1) {
         ci = permutation[i];
-        mkspan += distance[pred_ci][ci];
-        if (mkspan < window_start[ci]) {
-            mkspan = window_start[ci];
-        } else if (mkspan > window_end[ci]) {
+        mkspan += instance->distance[pred_ci][ci];
+        if (mkspan < instance->window_start[ci]) {
+            mkspan = instance->window_start[ci];
+        } else if (mkspan > instance->window_end[ci]) {
             return 2; /* This is infeasible and all similar moves will be as well */
         }
         pred_ci = ci;
-        makespan[j] = mkspan;
-        i--, j++;
+        makespan[k++] = mkspan;
+        i--;
     }
     
     // Check feasibility of the rest
     for (i = h3 + 1, pred_ci = permutation[h1 + 1];
-         i < n + 1;
+         i < instance->n + 1;
          i++, pred_ci = ci) {
         ci = permutation[i];
-        mkspan += distance[pred_ci][ci];
+        mkspan += instance->distance[pred_ci][ci];
         // We had to wait before ...
-        if (makespan[i] <= window_start[ci]) {
-            if (mkspan <= window_start[ci]) {
+        if (this->_makespan[i] <= instance->window_start[ci]) {
+            if (mkspan <= instance->window_start[ci]) {
                 // ... we still have to wait and everything else stays the same.
-                makespan[i] = window_start[ci];
-                i++;
+                makespan[k++] = instance->window_start[ci];
                 break;
             }
         } else {// We did not have to wait ...
-            if (mkspan <= window_start[ci]) {
+            if (mkspan <= instance->window_start[ci]) {
                 // ... we now have to wait so everything changes.
-                mkspan = makespan[i] = window_start[ci];
+                mkspan = makespan[k++] = instance->window_start[ci];
                 continue;
             }
         }
-        if (mkspan > window_end[ci]) {
+        if (mkspan > instance->window_end[ci]) {
             // ... we do not wait but we break a constraint.
             return 1; // If we moved ci earlier, it could be feasible.
-            break;
         }
-        makespan[i] = mkspan;
+        makespan[k++] = mkspan;
     }
-    // i is now one after the last affected.
-    // copy range affected from temp makespan to current solution.
-    std::copy(makespan.begin() + h1 + 1, makespan.begin() + i, 
-              this->_makespan.begin() + h1 + 1);
+    // copy range affected to current solution.
+    std::copy(makespan, makespan + k, this->_makespan.begin() + h1 + 1);
     return 0;
 }
 
@@ -1795,7 +2099,7 @@ Solution::two_opt_move(int h1, int h3)
 bool
 Solution::two_opt_first (Random &rng)
 {
-    assert (is_symmetric);
+    assert (instance->is_symmetric);
 
     //if (_constraint_violations > 0) return false;
     assert(_constraint_violations == 0);
@@ -1804,22 +2108,22 @@ Solution::two_opt_first (Random &rng)
 
     int c1, c2, s1, s2;
 
-    vector<int> rand_nodes = rng.generate_vector(n);
+    vector<int> rand_nodes = rng.generate_vector(instance->n);
 
     while (!rand_nodes.empty()) {
         int pos_c1 = rand_nodes.back();
         rand_nodes.pop_back();
         c1 = permutation[pos_c1];
         s1 = permutation[pos_c1 + 1];
-        number_t radius = distance[c1][s1];
+        number_t radius = instance->distance[c1][s1];
 
-        for (int h = pos_c1 + 2; h < n; h++) {
+        for (int h = pos_c1 + 2; h < instance->n; h++) {
             int pos_c2 = h;
             c2 = permutation[pos_c2];
-            if (tw_infeasible[c2][s1]) break;
+            if (instance->tw_infeasible[c2][s1]) break;
             s2 = permutation[h + 1];
-            number_t gain = distance[c1][c2] + distance[s1][s2]
-                - radius - distance[c2][s2];
+            number_t gain = instance->distance[c1][c2] + instance->distance[s1][s2]
+                - radius - instance->distance[c2][s2];
             if (gain >= 0) continue;
 
             int infeas = two_opt_is_infeasible (pos_c1, pos_c2);
@@ -1835,7 +2139,7 @@ Solution::two_opt_first (Random &rng)
                 _tourcost += gain;
                 DEBUG1 (assert_solution());
                 improved = true;
-                rand_nodes = rng.generate_vector(n);
+                rand_nodes = rng.generate_vector(instance->n);
                 break;
             }
         }
@@ -1846,113 +2150,35 @@ Solution::two_opt_first (Random &rng)
 bool
 Solution::two_opt_first (void)
 {
-    assert (is_symmetric);
+    assert (instance->is_symmetric);
 
     if (_constraint_violations > 0) return false;
 
     bool improved = false;
 
-    int h2, h4;
     int c1, c2, s_c1, s_c2;
 
-    std::vector<number_t> makespan = _makespan;
-
-    for (int pos_c1 = 0; pos_c1 < n; pos_c1++) {
+    for (int pos_c1 = 0; pos_c1 < instance->n; pos_c1++) {
         c1 = permutation[pos_c1];
         s_c1 = permutation[pos_c1 + 1];
-        number_t radius = distance[c1][s_c1];
-        for (int h = pos_c1 + 2; h < n; h++) {
+        number_t radius = instance->distance[c1][s_c1];
+        for (int h = pos_c1 + 2; h < instance->n; h++) {
             c2 = permutation[h];
             s_c2 = permutation[h + 1];
-            if (tw_infeasible[c2][s_c1]) break;
-            if (radius <= distance[c1][c2]) continue;
-            number_t gain = - radius + distance[c1][c2] 
-                + distance[s_c1][s_c2] - distance[c2][s_c2];
+            if (instance->tw_infeasible[c2][s_c1]) break;
+            if (radius <= instance->distance[c1][c2]) continue;
+            number_t gain = - radius + instance->distance[c1][c2] 
+                + instance->distance[s_c1][s_c2] - instance->distance[c2][s_c2];
             if (gain >= 0) continue;
-            h2 = s_c1; h4 = s_c2;
-            int pos_h2 = pos_c1 + 1;
-            int pos_h3 = h;
-            int pos_h4 = h + 1;
-            int i = pos_h2;
-            int j = pos_h3; 
-            int ci, cj;
-            int pred_cj = c1;
-            makespan = _makespan;
-            bool infeasible = false;
-            int mkspan = _makespan[pos_c1];
-            // Check feasibility of the reversed part.
-            while (j >= pos_h2) {
-                cj = permutation[j];
-                /* We don't need to check this because the solution is assumed to be feasible
-                   if (_neighbor.solution._makespan[j] > window_end[cj])
-                   delta_constraint_violations--;
-                */
-                mkspan = max (mkspan + distance[pred_cj][cj], window_start[cj]);
-                if (mkspan > window_end[cj]) {
-                    infeasible = true;
-                    break;
-                }
-                pred_cj = cj;
-                makespan[i] = mkspan;
-                j--; i++;
-            }
-            if (infeasible) break;
-            // Check feasibility of the rest
-            for (j = pos_h4, cj = h4, pred_cj = h2;
-                 j < n + 1;
-                 j++, pred_cj = cj) {
-                cj = permutation[j];
-                mkspan += distance[pred_cj][cj];
-                // We had to wait before ...
-                if (makespan[j] <= window_start[cj]) {
-                    if (mkspan <= window_start[cj]) {
-                        // ... we still have to wait and everything else stays the same.
-                        makespan[j] = window_start[cj];
-                        j++;
-                        break;
-                    }
-                } else {// We did not have to wait ...
-                    /*
-                      if (makespan[j] > window_end[cj])
-                      // ... we broke a constraint before.
-                      _constraint_violations--;
-                    */
-                    
-                    if (mkspan <= window_start[cj]) {
-                        // ... we now have to wait so everything changes.
-                        mkspan = makespan[j] = window_start[cj];
-                        continue;
-                    }
-                }
-                if (mkspan > window_end[cj]) {
-                    // ... we do not wait but we break a constraint.
-                    infeasible = true;
-                    break;
-                }
-                makespan[j] = mkspan;
-            }
-            int last_pos = j;
-
-            if (infeasible) break;
-
-            /* reverse inner part from pos_h2 to pos_h3 */
-            i = pos_h2; j = pos_h3;
-            while (i < j) {
-                ci = permutation[i];
-                cj = permutation[j];
-                permutation[i] = cj;
-                permutation[j] = ci;
-                i++; j--;
-            }
-            DEBUG2_FUNPRINT ("improved (%d, %d): %g -> %g\n", pos_h2, pos_h3,
-                             _tourcost, _tourcost + gain);
+            if (two_opt_is_infeasible (pos_c1, h)) break;
+
+            two_opt_move(pos_c1, h);
+            DEBUG2_FUNPRINT ("improved (%d, %d): %g -> %g\n", pos_c1 + 1, h,
+                             double(_tourcost), double(_tourcost + gain));
             _tourcost += gain;
-            // copy range affected from temp makespan to current solution.
-            std::copy(makespan.begin() + pos_h2, makespan.begin() + last_pos, 
-                      this->_makespan.begin() + pos_h2);
             DEBUG1 (assert_solution());
             s_c1 = permutation[pos_c1 + 1];
-            radius = distance[c1][s_c1];
+            radius = instance->distance[c1][s_c1];
             improved = true;
         }
     }
@@ -1971,7 +2197,7 @@ Solution::localsearch_2opt_first (void)
 // FIXME: This a bit of a hack. Do a partial evaluation.
 void Solution::full_eval(void)
 {
-    Solution tmp;
+    Solution tmp (instance, evaluations);
     std::vector<int> sub(this->permutation.begin() + 1, this->permutation.end() - 2);
     tmp.add(&sub.front());
     *this = tmp;
@@ -1982,24 +2208,24 @@ Solution::perturb_1shift_feasible(int level, Random &rng)
 {
     assert (_constraint_violations == 0);
     assert(level > 0);
-    int num = min(n, level);
+    int num = min(instance->n, level);
     DEBUG2_PRINT("# perturb_insert: %d (%d%%)\n", num, percent);
 
     std::vector<int> index;
-    index.resize(n - 2);
-    for (int k = 0; k < n - 2; k++) {
+    index.resize(instance->n - 2);
+    for (int k = 0; k < instance->n - 2; k++) {
         index[k] = k + 1;
     }
 
-    Solution ngh;
+    Solution ngh (instance, evaluations);
 
-    for (int j = n - 1; j >= 0; j--) {
+    for (int j = instance->n - 1; j >= 0; j--) {
         // Knuth shuffle
         int k = rng.rand_int (j + 1);
         std::swap(index[k], index[j]);
         k = index[j];
-        assert(k > 0 && k < n);
-        int pos = 1 + rng.rand_int (n - 3);
+        assert(k > 0 && k < instance->n);
+        int pos = 1 + rng.rand_int (instance->n - 3);
         if (pos == k) continue;
 
         DEBUG3_PRINT("%d -> [ %d, %d] = %d\n", k, 1, permutation.size() - 2, pos);
@@ -2011,18 +2237,18 @@ Solution::perturb_1shift_feasible(int level, Random &rng)
         
         ngh = *this;
         number_t delta_cost = 0;
-        int first_m = n + 1;
+        int first_m = instance->n + 1;
         // FIXME: the bodies of the for-loops are the same, merge them.
         if (k < pos) {// Forward
             for (int d = k; d < pos; d++) {
                 int ci = ngh.permutation[d];
                 int cj = ngh.permutation[d+1];
-                if (tw_infeasible[cj][ci]) break;
+                if (instance->tw_infeasible[cj][ci]) break;
                 delta_cost += ngh.do_swap(d);
                 if (ngh.is_feasible_swap(d, first_m)) {
                     assert(ngh.constraint_violations() == 0);
                     assert(this->_tourcost + delta_cost == ngh._tourcost);
-                    assert(first_m == n + 1);
+                    assert(first_m == instance->n + 1);
                     *this = ngh;
                     DEBUG1 (assert_solution());
                     delta_cost = 0;
@@ -2032,12 +2258,12 @@ Solution::perturb_1shift_feasible(int level, Random &rng)
             for (int d = k - 1; d >= pos; d--) {
                 int ci = ngh.permutation[d];
                 int cj = ngh.permutation[d+1];
-                if (tw_infeasible[cj][ci]) break;
+                if (instance->tw_infeasible[cj][ci]) break;
                 delta_cost += ngh.do_swap(d);
                 if (ngh.is_feasible_swap(d, first_m)) {
                     assert(ngh.constraint_violations() == 0);
                     assert(this->_tourcost + delta_cost == ngh._tourcost);
-                    assert(first_m == n + 1);
+                    assert(first_m == instance->n + 1);
                     *this = ngh;
                     DEBUG1 (assert_solution());
                     delta_cost = 0;
@@ -2056,22 +2282,84 @@ Solution::perturb_1shift_feasible(int level, Random &rng)
     DEBUG1(assert_solution());
 }
 
+/* Recompute _makespan, _constraint_violations and _infeasibility after
+   permuting the customers in positions [first, last]. cviols and
+   infeas are the violations of the customers that were in those
+   positions before. Start times after last are only recomputed until
+   they agree with the old ones, as in swap().  */
+void
+Solution::reschedule (int first, int last, int cviols, number_t infeas)
+{
+    _constraint_violations -= cviols;
+    _infeasibility -= infeas;
+
+    number_t mkspan = _makespan[first - 1];
+    int i;
+    for (i = first; i < instance->n + 1; i++) {
+        int prev = permutation[i - 1];
+        int current = permutation[i];
+        mkspan = max (mkspan + instance->distance[prev][current],
+                      instance->window_start[current]);
+        if (i > last) {
+            // Same customer as before.
+            if (mkspan == _makespan[i]) break;
+            if (_makespan[i] > instance->window_end[current]) {
+                _constraint_violations--;
+                _infeasibility -= _makespan[i] - instance->window_end[current];
+            }
+        }
+        if (mkspan > instance->window_end[current]) {
+            _constraint_violations++;
+            _infeasibility += mkspan - instance->window_end[current];
+        }
+        _makespan[i] = mkspan;
+    }
+    *evaluations += i - first;
+}
+
 void
 Solution::perturb_1shift(int level, Random &rng)
 {
     assert(level > 0);
-    int num = min(n, level);
+    int num = min(instance->n, level);
     DEBUG2_PRINT("# perturb_insert: %d (%d)\n", num, level);
 
-    int earliest = n;
+    /* Positions [earliest, latest] have been permuted. Before a move
+       extends them, add up the violations of the customers in the
+       positions that are about to change, and the cost of the edges
+       into them and into the position after the last one.  */
+    int earliest = instance->n, latest = 0;
+    int cviols = 0;
+    number_t infeas = 0;
+    number_t old_cost = 0;
+    auto extend = [&] (int first, int last) {
+        int lo = min(first, earliest);
+        int hi = max(last, latest);
+        bool empty = earliest > latest;
+        for (int i = lo; i <= hi + 1; i++) {
+            if (!empty && i >= earliest && i <= latest) {
+                i = latest; // Already counted.
+                continue;
+            }
+            int c = permutation[i];
+            if (i <= hi && _makespan[i] > instance->window_end[c]) {
+                cviols++;
+                infeas += _makespan[i] - instance->window_end[c];
+            }
+            if (empty || i != latest + 1)
+                old_cost += instance->distance[permutation[i - 1]][c];
+        }
+        earliest = lo;
+        latest = hi;
+    };
+
     do {
-        int k = 1 + rng.rand_int (n - 1);
+        int k = 1 + rng.rand_int (instance->n - 1);
         int pos;
         do {
-            pos = 1 + rng.rand_int (n - 1);
+            pos = 1 + rng.rand_int (instance->n - 1);
         } while (pos == k);
 
-        earliest = min(earliest, min(pos, k));
         DEBUG3_PRINT("%d -> [ %d, %d] = %d\n", k, 1, permutation.size() - 2, pos);
         DEBUG3(fprintf(stderr,"Before:");
                for(int _j = 1; _j <= permutation.size() - 2; _j++) {
@@ -2079,8 +2367,8 @@ Solution::perturb_1shift(int level, Random &rng)
                }
                fprintf(stderr, "\n"));
         
-        int tmp = permutation[k];
-        reinsert(permutation, tmp, k, pos);
+        extend(min(pos, k), max(pos, k));
+        reinsert(permutation, k, pos);
         DEBUG3(fprintf(stderr, "After :");
                for(int _j = 1; _j <= permutation.size() - 2; _j++) {
                    fprintf(stderr, " %2d", permutation[_j]);
@@ -2089,10 +2377,12 @@ Solution::perturb_1shift(int level, Random &rng)
         num--;
     } while (num > 0);
     
-    if (earliest < n) {
-        // FIXME: for large instances it would be better to do the
-        // evaluation incrementally from earliest to n
-        full_eval();
+    if (earliest < instance->n) {
+        number_t new_cost = 0;
+        for (int i = earliest; i <= latest + 1; i++)
+            new_cost += instance->distance[permutation[i - 1]][permutation[i]];
+        _tourcost += new_cost - old_cost;
+        reschedule(earliest, latest, cviols, infeas);
         DEBUG1(assert_solution());
     }
 }
@@ -38,10 +38,13 @@
 #include <string>
 #include <cstring>
 #include <climits>
+#include <atomic>
+#include <cstdint>
 
 #include "Random.h"
 #include "misc-math.h"
 #include "xvector.hpp" // For vector::reinsert
+#include "matrix.h"
 
 using namespace std;
 
@@ -78,33 +81,103 @@ enum heuristic_type_t {
 enum localsearch_type_t {
     LOCALSEARCH_NONE = 0,
     LOCALSEARCH_FIRST,
-    LOCALSEARCH_BEST
+    LOCALSEARCH_BEST,
+    LOCALSEARCH_OROPT
 };
 
-class Solution {
+/* Weights of the components of the heuristic information. uniform
+   means that all weights are zero, so the heuristic information is 1.  */
+struct hinfo_weights_t {
+    double distance;
+    double window_start;
+    double window_end;
+    bool uniform;
+};
+
+/* A problem instance and what is computed from it before solving it.
+   It does not change once loaded, so any number of solvers may share
+   it.  */
+class Instance {
 
 public:
 
-  static string instance;  
-  static int n;   // number of customers
-  static unsigned int evaluations;
+  /* Load the instance in filename. candidate_list_size is the length
+     of the candidate lists, 0 if they are not used.  */
+  Instance (string filename, int candidate_list_size = 0);
+
+  void print_parameters (string prefix="", FILE *stream=stdout) const;
+
+  double heuristic_information (const hinfo_weights_t &w,
+                                int prev, int next) const;
+  void heuristic_information_times (const hinfo_weights_t &w,
+                                    int prev, const double *scale,
+                                    double *out) const;
+
+  string filename;
+  int n;   // number of customers
+  bool is_symmetric;
+
+  // time-window start
+  vector<number_t> window_start;
+  number_t window_start_min, window_start_max;
+  
+  // time-window end
+  vector<number_t> window_end;
+  number_t window_end_min, window_end_max;
+
+  // travel time/distance
+  Matrix<number_t> distance;
+  number_t distance_min, distance_max;
+
+  // Normalised components of the heuristic information, which are
+  // combined with the weights drawn for each construction.
+  Matrix<double> hinfo_distance;
+  vector<double> hinfo_window_start;
+  vector<double> hinfo_window_end;
+
+  // Random keys of the customers for Solution::visited_hash.
+  vector<uint64_t> zobrist;
+
+  Matrix<unsigned char> tw_infeasible;
+  int num_tw_infeasible;
+
+  // Row i holds the customers that can be served soonest after i.
+  // candidate_list_size is 0 if there are no candidate lists.
+  Matrix<int> candidate_list;
+  int candidate_list_size;
+
+private:
+  void calculate_static_hinfo (void);
+  void init_zobrist (void);
+  void strong_time_window_infeasibility(void);
+  void build_candidate_lists (int size);
+};
+
+class Solution {
+
+public:
 
   static heuristic_type_t heuristic_type;
   static localsearch_type_t localsearch_type;
 
-  static bool is_symmetric;
-  static void LoadInstance (string filename);
-  static void print_parameters (string prefix="", FILE *stream=stdout);
   static void print_compile_parameters (FILE *stream=stdout);
 
   static bool set_heuristic_weights (char *arg);
   static string get_heuristic_type(void);
   static string get_localsearch_type(void);
-  static double heuristic_information (int prev, int next);
-  static void randomize_hinfo (Random *rng);
+  static hinfo_weights_t random_hinfo_weights (Random *rng);
+
+  // Shared by all solutions of a solver. evaluations is updated
+  // concurrently when several solutions are built in parallel.
+  const Instance *instance;
+  atomic<unsigned int> *evaluations;
 
   vector<int> permutation;
-  vector<bool> node_assigned;
+  // Zobrist hash of the set of assigned customers (see add()).
+  uint64_t visited_hash;
+  // One byte per node rather than vector<bool>, so that loops over
+  // the mask can be vectorised.
+  vector<unsigned char> node_assigned;
   int nodes_available;
 
   int _constraint_violations;
@@ -112,24 +185,32 @@ public:
   number_t _lower_bound;
   int _lower_bound_constraint_violations;
 
-  Solution (void) 
-    : permutation (1,0), // Start at the depot.
-      node_assigned(n, false),
-      nodes_available (n),
+  Solution (const Instance *instance, atomic<unsigned int> *evaluations)
+    : instance (instance),
+      evaluations (evaluations),
+      permutation (1,0), // Start at the depot.
+      visited_hash (0),
+      node_assigned(instance->n, 0),
+      nodes_available (instance->n),
       _constraint_violations (0),
       _infeasibility(0),
       _lower_bound (-1),
       _lower_bound_constraint_violations (-1),
-      _makespan (n+1),
+      _makespan (instance->n+1),
       _tourcost (0)
   {
-    permutation.reserve (n+1);
+    permutation.reserve (instance->n+1);
     node_assigned[0] = true;
     nodes_available--;
   };
 
+  // Ants are deleted through pointers to Solution.
+  virtual ~Solution () {};
+
   // Named-Constructor
-  static Solution * RandomSolution (Random *rnd);
+  static Solution * RandomSolution (const Instance *instance,
+                                    atomic<unsigned int> *evaluations,
+                                    Random *rnd);
 
   Solution * clone(void) { return new Solution(*this); };
 
@@ -147,19 +228,29 @@ public:
   bool check_solution() const;
     bool check_partial_solution(int max_node) const;
     void assert_solution() const;
+  int feasible_candidates (int last, vector<int> &out) const;
   bool better_than (const Solution * other) const;
   bool better_than (const Solution & other) const { return better_than (&other); };
   void add(int current, int node);
+  unsigned int append(int current, int node);
+  void evaluate_add (int node, int &cviols, number_t &mkspan,
+                     number_t &tourcost) const;
+  uint64_t visited_hash_after_add (int node) const {
+    return visited_hash ^ instance->zobrist[node];
+  }
   void add (const int p[]);
     // FIXME: Change this to a function pointer.
   Solution * localsearch (void) {
     switch (localsearch_type) {
     case LOCALSEARCH_FIRST: return localsearch_first();
     case LOCALSEARCH_BEST:  return localsearch_best();
+    case LOCALSEARCH_OROPT: return localsearch_oropt();
     default: abort();
     }
   }
   Solution * localsearch_2opt_first (void);
+  Solution * localsearch_oropt (void);
+  bool oropt_first (void);
   bool feasibility_1shift_first(void);
   bool feasibility_1shift_first(Random &rng);
     bool feasible_1shift_first();
@@ -174,7 +265,9 @@ bool forward_violated(bool &improved, Random &rng);
 bool backward_nonviolated(bool &improved, Random &rng);
 bool feasibility_1shift_first_code(Random &rng);
 bool feasibility_1shift_first_paper(Random &rng);
-bool insertion_is_feasible(int from, int to);
+void forward_slack(vector<number_t> &slack) const;
+bool insertion_is_feasible(int from, int to, const vector<number_t> &slack,
+                           unsigned int &count) const;
     void full_eval(void);
     bool ls_feasibility_1shift_first(void);
     bool ls_feasibility_1shift_first(Random &rng);
@@ -192,42 +285,22 @@ private:
   vector<number_t> _makespan;
   number_t _tourcost; // Sum of the traversal cost along the tour.
 
-  static double dist_heuristic_weight;
-  static double winstart_heuristic_weight;
-  static double winend_heuristic_weight;
-  static vector<vector<double> > heuristic_info;
-#if DEBUG>=1
-  static bool heuristic_info_ready;
-#endif
-
-  static void calculate_static_hinfo (void);
-  static double weighted_hinfo (int prev, int next,
-                                double dist_w,
-                                double winstart_w,
-                                double winend_w);
-
-  // time-window start
-  static vector<number_t> window_start;
-  static number_t window_start_min, window_start_max;
-  
-  // time-window end
-  static vector<number_t> window_end;
-  static number_t window_end_min, window_end_max;
-
-  // travel time/distance
-  static vector<vector<number_t> > distance;
-  static number_t distance_min, distance_max;
-
-  static vector<vector<bool> > tw_infeasible;
-  static int num_tw_infeasible;
-  static void strong_time_window_infeasibility(void);
+  static hinfo_weights_t heuristic_weights;
 
   bool inline infeasible_move (int initial, int final) const;
   void swap (int k);
+  void reschedule (int first, int last, int cviols, number_t infeas);
   void insertion_move (int k, int i, int d);
   Solution * localsearch_insertion (bool first_improvement_p);
+  Solution * localsearch_insertion_feasible (bool first_improvement_p);
   Solution * localsearch_first (void) { return localsearch_insertion(true); };
   Solution * localsearch_best (void) { return localsearch_insertion(false); };
+  int oropt_customer (int i, int len, int j, int p) const;
+  bool oropt_evaluate (int i, int len, int j, int &cviols,
+                       number_t &infeas, number_t &mkspan_end) const;
+  void oropt_move (int i, int len, int j, number_t delta_cost,
+                   int cviols, number_t infeas);
+  bool oropt_improves (int i, int len, int j, number_t delta_cost);
     number_t delta_swap(int k);
     bool is_feasible_swap(int k, int &first_m);
     number_t do_swap(int k);
@@ -235,17 +308,24 @@ private:
 
 
 inline double 
-Solution::heuristic_information (int prev, int next)
+Instance::heuristic_information (const hinfo_weights_t &w,
+                                 int prev, int next) const
 {
-  assert (Solution::heuristic_info_ready);
+  if (prev == next) return 0.0;
 
-  return heuristic_info[prev][next];
-  /*  return weighted_hinfo (prev, next, 
-                         dist_heuristic_weight,
-                         winstart_heuristic_weight,
-                         winend_heuristic_weight);*/
-}
+  /* ??? We cannot return zero here because this might be the only
+     remaining option for an ant. It would be better to return zero
+     here and if the ant does no have any option with higher than zero
+     desirability, then choose between the options with zero
+     desirability.  */
+  //if (tw_infeasible[prev][next]) return 1e-6;
 
+  if (w.uniform) return 1.;
+
+  return w.distance * hinfo_distance[prev][next]
+    + w.window_start * hinfo_window_start[next]
+    + w.window_end * hinfo_window_end[next];
+}
 
 /*
 template<typename T_type>